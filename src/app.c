@@ -28,6 +28,11 @@
 #include "http.h"
 #include "wnd-tube-status.h"
 #include "wnd-main-menu.h"
+#include "wnd-next-bus.h"
+#include "wnd-line-detail.h"
+#include "status-store.h"
+#include "request-scheduler.h"
+#include "outbox.h"
 
 #if ROCKSHOT
 #include "rockshot.h"
@@ -43,14 +48,18 @@
 PBL_APP_INFO(MY_UUID, "London Transport", "Matthew Tole", VERSION_MAJOR, VERSION_MINOR,  RESOURCE_ID_MENU_ICON, APP_INFO_STANDARD_APP);
 
 static void handle_init(AppContextRef ctx);
+static void handle_timer(AppContextRef ctx, AppTimerHandle handle, uint32_t cookie);
 static void http_failure(int32_t cookie, int http_status, void* context);
 static void http_success(int32_t cookie, int http_status, DictionaryIterator* received, void* context);
 static void http_reconnect(void* context);
+static void http_cookie_received(int32_t request_id, Tuple* result, void* context);
+static void http_cookie_stored(int32_t request_id, bool successful, void* context);
 
 void pbl_main(void *params) {
 
   PebbleAppHandlers handlers = {
     .init_handler = &handle_init,
+    .timer_handler = &handle_timer,
     .messaging_info = {
       .buffer_sizes = {
         .inbound = 256,
@@ -70,17 +79,22 @@ void handle_init(AppContextRef ctx) {
   http_set_app_id(76782703);
 
   resource_init_current_app(&APP_RESOURCES);
+  request_scheduler_init(ctx);
 
-  wnd_tube_status_init();
+  wnd_tube_status_init(ctx);
+  wnd_next_bus_init();
+  wnd_line_detail_init();
   wnd_main_menu_init();
+  outbox_init();
+  thanks_init();
 
   wnd_main_menu_show();
 
-  create_thanks_window();
-
   http_register_callbacks((HTTPCallbacks){
     .failure=http_failure,
-    .success=http_success
+    .success=http_success,
+    .cookie_get=http_cookie_received,
+    .cookie_set=http_cookie_stored
   }, (void*)ctx);
 
   #if ROCKSHOT
@@ -88,18 +102,49 @@ void handle_init(AppContextRef ctx) {
   #endif
 }
 
-void http_failure(int32_t cookie, int http_status, void* context) {
+void handle_timer(AppContextRef ctx, AppTimerHandle handle, uint32_t cookie) {
+  if (request_scheduler_timer(handle)) {
+    return;
+  }
   switch (cookie) {
-    case HTTP_TUBE_STATUS:
-      wnd_tube_http_failure(cookie, http_status, context);
+    case TIMER_TUBE_REFRESH:
+      wnd_tube_status_refresh_timer();
     break;
   }
 }
 
+// Responses are routed to the handlers each request registered with the
+// scheduler. Failures are retried there first and only reach the request's
+// failure handler once the scheduler gives up. A response also means the
+// outbound message is free, so anything the cookie store couldn't send
+// goes first.
+void http_failure(int32_t cookie, int http_status, void* context) {
+  status_store_flush();
+  request_scheduler_failure(cookie, http_status, context);
+}
+
 void http_success(int32_t cookie, int http_status, DictionaryIterator* received, void* context) {
-  switch (cookie) {
-    case HTTP_TUBE_STATUS:
-      wnd_tube_http_success(cookie, http_status, received, context);
+  status_store_flush();
+  request_scheduler_success(cookie, http_status, received, context);
+  // The outbox's own reply says nothing new about the phone, and flushing
+  // on it would resend anything the server left out straight away.
+  if (cookie != HTTP_OUTBOX) {
+    outbox_flush();
+  }
+}
+
+void http_cookie_received(int32_t request_id, Tuple* result, void* context) {
+  switch (request_id) {
+    case STATUS_STORE_REQUEST:
+      status_store_cookie_get(request_id, result, context);
+    break;
+  }
+}
+
+void http_cookie_stored(int32_t request_id, bool successful, void* context) {
+  switch (request_id) {
+    case STATUS_STORE_REQUEST:
+      status_store_cookie_set(request_id, successful, context);
     break;
   }
 }
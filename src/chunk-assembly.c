@@ -0,0 +1,175 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "chunk-assembly.h"
+
+static bool read_uint(Tuple* tuple, uint32_t* value);
+static int next_missing_chunk(ChunkAssembly* assembly);
+static bool chunks_cover_total(ChunkAssembly* assembly);
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+// Either handler may be NULL. The chunk handler sees every new chunk as it
+// is stored, for consumers that can parse incrementally.
+void chunk_assembly_init(ChunkAssembly* assembly, uint8_t* arena, uint16_t arena_size, ChunkHandler chunk, ChunkCompleteHandler complete) {
+  assembly->arena = arena;
+  assembly->arena_size = arena_size;
+  assembly->chunk = chunk;
+  assembly->complete = complete;
+  chunk_assembly_reset(assembly);
+}
+
+void chunk_assembly_reset(ChunkAssembly* assembly) {
+  assembly->transfer = 0;
+  assembly->total = 0;
+  assembly->count = 0;
+  assembly->received = 0;
+}
+
+ChunkResult chunk_assembly_add(ChunkAssembly* assembly, DictionaryIterator* received) {
+  Tuple* tuple_transfer = dict_find(received, CHUNK_KEY_TRANSFER);
+  Tuple* tuple_index = dict_find(received, CHUNK_KEY_INDEX);
+  Tuple* tuple_count = dict_find(received, CHUNK_KEY_COUNT);
+  Tuple* tuple_offset = dict_find(received, CHUNK_KEY_OFFSET);
+  Tuple* tuple_total = dict_find(received, CHUNK_KEY_TOTAL);
+  Tuple* tuple_data = dict_find(received, CHUNK_KEY_DATA);
+  if (! tuple_transfer || ! tuple_index || ! tuple_count || ! tuple_offset || ! tuple_total || ! tuple_data) {
+    return CHUNK_ERROR;
+  }
+
+  uint32_t transfer;
+  uint32_t index;
+  uint32_t count;
+  uint32_t offset;
+  uint32_t total;
+  if (! read_uint(tuple_transfer, &transfer) || ! read_uint(tuple_index, &index) || ! read_uint(tuple_count, &count) ||
+    ! read_uint(tuple_offset, &offset) || ! read_uint(tuple_total, &total) || tuple_data->type != TUPLE_BYTE_ARRAY) {
+    return CHUNK_ERROR;
+  }
+  uint16_t length = tuple_data->length;
+
+  if (transfer > 0xFFFF || total > assembly->arena_size || count == 0 || count > CHUNK_MAX_CHUNKS || index >= count || offset + length > total) {
+    return CHUNK_ERROR;
+  }
+
+  // A different transfer id means the server started over, so anything
+  // collected so far is thrown away.
+  if (transfer != assembly->transfer || total != assembly->total || count != assembly->count) {
+    assembly->transfer = transfer;
+    assembly->total = total;
+    assembly->count = count;
+    assembly->received = 0;
+  }
+
+  if (! (assembly->received & ((uint32_t)1 << index))) {
+    memcpy(assembly->arena + offset, tuple_data->value->data, length);
+    assembly->received |= ((uint32_t)1 << index);
+    assembly->offsets[index] = offset;
+    assembly->lengths[index] = length;
+    if (assembly->chunk) {
+      assembly->chunk(transfer, assembly->arena + offset, offset, length);
+    }
+  }
+
+  if (next_missing_chunk(assembly) >= 0) {
+    return CHUNK_INCOMPLETE;
+  }
+  // Chunks that leave a gap would hand over whatever an earlier transfer
+  // left in the arena, so the transfer is started again instead.
+  if (! chunks_cover_total(assembly)) {
+    chunk_assembly_reset(assembly);
+    return CHUNK_ERROR;
+  }
+  if (assembly->complete) {
+    assembly->complete(transfer, assembly->arena, assembly->total);
+  }
+  return CHUNK_COMPLETE;
+}
+
+// Asks for the first chunk not yet received. Nothing is written before the
+// first chunk arrives, so the server starts a new transfer.
+void chunk_assembly_write_request(ChunkAssembly* assembly, DictionaryIterator* body) {
+  int missing = next_missing_chunk(assembly);
+  if (assembly->count == 0 || missing < 0) {
+    return;
+  }
+  dict_write_uint16(body, CHUNK_KEY_TRANSFER, assembly->transfer);
+  dict_write_uint8(body, CHUNK_KEY_INDEX, missing);
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+// Negative numbers are rejected rather than read as huge ones.
+bool read_uint(Tuple* tuple, uint32_t* value) {
+  if (tuple->type != TUPLE_UINT && tuple->type != TUPLE_INT) {
+    return false;
+  }
+  bool is_signed = tuple->type == TUPLE_INT;
+  switch (tuple->length) {
+    case 1:
+      *value = tuple->value->uint8;
+      return ! (is_signed && tuple->value->int8 < 0);
+    case 2:
+      *value = tuple->value->uint16;
+      return ! (is_signed && tuple->value->int16 < 0);
+    case 4:
+      *value = tuple->value->uint32;
+      return ! (is_signed && tuple->value->int32 < 0);
+  }
+  return false;
+}
+
+int next_missing_chunk(ChunkAssembly* assembly) {
+  for (int c = 0; c < assembly->count; c += 1) {
+    if (! (assembly->received & ((uint32_t)1 << c))) {
+      return c;
+    }
+  }
+  return assembly->count == 0 ? 0 : -1;
+}
+
+// Walks forward from the start of the payload, each step jumping to the
+// furthest end of any chunk that starts at or before the current point.
+bool chunks_cover_total(ChunkAssembly* assembly) {
+  uint32_t covered = 0;
+  while (covered < assembly->total) {
+    uint32_t furthest = covered;
+    for (int c = 0; c < assembly->count; c += 1) {
+      uint32_t end = assembly->offsets[c] + assembly->lengths[c];
+      if (assembly->offsets[c] <= covered && end > furthest) {
+        furthest = end;
+      }
+    }
+    if (furthest == covered) {
+      return false;
+    }
+    covered = furthest;
+  }
+  return true;
+}
@@ -0,0 +1,71 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef CHUNK_ASSEMBLY_H
+#define CHUNK_ASSEMBLY_H
+
+// Reassembles payloads too large for one inbound message. The server
+// sends each chunk with the keys below; the watch asks for chunks one at
+// a time by writing the transfer id and the next missing chunk index into
+// the following request. Chunks are placed by offset, so duplicates and
+// out of order chunks are harmless, and a lost chunk is simply asked for
+// again. The numbers are unsigned integers and the data a byte array; a
+// transfer only completes once its chunks cover every byte of the total.
+
+#define CHUNK_KEY_TRANSFER 0xFF00
+#define CHUNK_KEY_INDEX 0xFF01
+#define CHUNK_KEY_COUNT 0xFF02
+#define CHUNK_KEY_OFFSET 0xFF03
+#define CHUNK_KEY_TOTAL 0xFF04
+#define CHUNK_KEY_DATA 0xFF05
+
+#define CHUNK_MAX_CHUNKS 32
+
+typedef enum {
+  CHUNK_INCOMPLETE,
+  CHUNK_COMPLETE,
+  CHUNK_ERROR
+} ChunkResult;
+
+typedef void (*ChunkHandler)(uint16_t transfer, const uint8_t* data, uint16_t offset, uint16_t length);
+typedef void (*ChunkCompleteHandler)(uint16_t transfer, const uint8_t* data, uint16_t length);
+
+typedef struct {
+  uint8_t* arena;
+  uint16_t arena_size;
+  uint16_t transfer;
+  uint16_t total;
+  uint8_t count;
+  uint32_t received;
+  uint16_t offsets[CHUNK_MAX_CHUNKS];
+  uint16_t lengths[CHUNK_MAX_CHUNKS];
+  ChunkHandler chunk;
+  ChunkCompleteHandler complete;
+} ChunkAssembly;
+
+void chunk_assembly_init(ChunkAssembly* assembly, uint8_t* arena, uint16_t arena_size, ChunkHandler chunk, ChunkCompleteHandler complete);
+void chunk_assembly_reset(ChunkAssembly* assembly);
+ChunkResult chunk_assembly_add(ChunkAssembly* assembly, DictionaryIterator* received);
+void chunk_assembly_write_request(ChunkAssembly* assembly, DictionaryIterator* body);
+
+#endif // CHUNK_ASSEMBLY_H
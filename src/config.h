@@ -28,4 +28,8 @@
 #define ANDROID true
 #define ROCKSHOT true
 
+// Every request goes to this host. Point it at a machine running
+// tools/fake-api.py to try the app against scripted responses.
+#define API_BASE_URL "http://api.pblweb.com"
+
 #endif // CONFIG_H
\ No newline at end of file
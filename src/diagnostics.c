@@ -0,0 +1,128 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "diagnostics.h"
+
+#define NUM_BUCKETS 6
+#define SECONDS_PER_DAY (24 * 60 * 60)
+
+typedef struct {
+  const char* name;
+  uint16_t bounds[NUM_BUCKETS - 1];
+} HistogramInfo;
+
+static void append(char* buffer, uint16_t size, const char* text);
+
+static const char* counter_names[NUM_DIAG_COUNTERS] = {
+  "Requests",
+  "Responses",
+  "Failures",
+  "Parses",
+  "Parse errors",
+  "Relayouts",
+  "Redraws",
+  "Row draws",
+  "Height calls",
+  "Unregistered",
+  "Store drops"
+};
+
+// A value goes in the first bucket whose bound it is below, or in the
+// last bucket if it is above them all.
+static const HistogramInfo histogram_info[NUM_DIAG_HISTOGRAMS] = {
+  { "Latency (s)", { 1, 2, 4, 8, 16 } },
+  { "Request bytes", { 32, 64, 128, 192, 256 } },
+  { "Response bytes", { 32, 64, 128, 192, 256 } }
+};
+
+static uint32_t counters[NUM_DIAG_COUNTERS];
+static uint16_t histograms[NUM_DIAG_HISTOGRAMS][NUM_BUCKETS];
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+void diagnostics_count(DiagCounter counter) {
+  counters[counter] += 1;
+}
+
+uint32_t diagnostics_counter(DiagCounter counter) {
+  return counters[counter];
+}
+
+void diagnostics_record(DiagHistogram histogram, uint32_t value) {
+  uint8_t b = 0;
+  while (b < NUM_BUCKETS - 1 && value >= histogram_info[histogram].bounds[b]) {
+    b += 1;
+  }
+  histograms[histogram][b] += 1;
+}
+
+// The only clock apps have is the wall clock, so timings are in seconds.
+uint32_t diagnostics_now() {
+  PblTm now;
+  get_time(&now);
+  return (now.tm_hour * 60 + now.tm_min) * 60 + now.tm_sec;
+}
+
+uint32_t diagnostics_since(uint32_t start) {
+  uint32_t now = diagnostics_now();
+  return now >= start ? now - start : now + SECONDS_PER_DAY - start;
+}
+
+uint16_t diagnostics_dict_size(DictionaryIterator* iter) {
+  return (uint8_t*)iter->cursor - (uint8_t*)iter->dictionary;
+}
+
+void diagnostics_format(char* buffer, uint16_t size) {
+  char line[40];
+  buffer[0] = '\0';
+  for (int c = 0; c < NUM_DIAG_COUNTERS; c += 1) {
+    snprintf(line, sizeof(line), "%s: %lu\n", counter_names[c], (unsigned long)counters[c]);
+    append(buffer, size, line);
+  }
+  for (int h = 0; h < NUM_DIAG_HISTOGRAMS; h += 1) {
+    snprintf(line, sizeof(line), "\n%s\n", histogram_info[h].name);
+    append(buffer, size, line);
+    for (int b = 0; b < NUM_BUCKETS; b += 1) {
+      if (b < NUM_BUCKETS - 1) {
+        snprintf(line, sizeof(line), "<%u: %u\n", histogram_info[h].bounds[b], histograms[h][b]);
+      }
+      else {
+        snprintf(line, sizeof(line), "%u+: %u\n", histogram_info[h].bounds[b - 1], histograms[h][b]);
+      }
+      append(buffer, size, line);
+    }
+  }
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+void append(char* buffer, uint16_t size, const char* text) {
+  uint16_t length = strlen(buffer);
+  strncpy(buffer + length, text, size - length - 1);
+  buffer[size - 1] = '\0';
+}
@@ -0,0 +1,60 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+// Counters and small fixed bucket histograms for working out where time
+// goes in the app. Everything is kept in memory for the current run and
+// shown on the diagnostics screen.
+
+typedef enum {
+  DIAG_REQUESTS,
+  DIAG_RESPONSES,
+  DIAG_FAILURES,
+  DIAG_PARSES,
+  DIAG_PARSE_ERRORS,
+  DIAG_RELAYOUTS,
+  DIAG_REDRAWS,
+  DIAG_ROW_DRAWS,
+  DIAG_HEIGHT_CALLS,
+  DIAG_UNREGISTERED,
+  DIAG_STORE_DROPPED,
+  NUM_DIAG_COUNTERS
+} DiagCounter;
+
+typedef enum {
+  DIAG_LATENCY,
+  DIAG_REQUEST_BYTES,
+  DIAG_RESPONSE_BYTES,
+  NUM_DIAG_HISTOGRAMS
+} DiagHistogram;
+
+void diagnostics_count(DiagCounter counter);
+uint32_t diagnostics_counter(DiagCounter counter);
+void diagnostics_record(DiagHistogram histogram, uint32_t value);
+uint32_t diagnostics_now();
+uint32_t diagnostics_since(uint32_t start);
+uint16_t diagnostics_dict_size(DictionaryIterator* iter);
+void diagnostics_format(char* buffer, uint16_t size);
+
+#endif // DIAGNOSTICS_H
@@ -0,0 +1,90 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "disruption-cache.h"
+
+// Disruption descriptions keyed by line code and status word, so a
+// description is fetched again as soon as the line's status changes.
+typedef struct {
+  char code[3];
+  uint32_t status;
+  uint32_t last_used;
+  char text[DISRUPTION_TEXT_LENGTH];
+} DisruptionEntry;
+
+static DisruptionEntry* find_entry(const char* code, uint32_t status);
+
+static DisruptionEntry entries[DISRUPTION_CACHE_SIZE];
+static uint32_t use_counter = 0;
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+const char* disruption_cache_get(const char* code, uint32_t status) {
+  DisruptionEntry* entry = find_entry(code, status);
+  if (! entry) {
+    return NULL;
+  }
+  use_counter += 1;
+  entry->last_used = use_counter;
+  return entry->text;
+}
+
+// Replaces the least recently used entry, or an empty one if there is one.
+void disruption_cache_put(const char* code, uint32_t status, const uint8_t* text, uint16_t length) {
+  DisruptionEntry* entry = find_entry(code, status);
+  if (! entry) {
+    entry = &entries[0];
+    for (int e = 1; e < DISRUPTION_CACHE_SIZE; e += 1) {
+      if (entries[e].last_used < entry->last_used) {
+        entry = &entries[e];
+      }
+    }
+  }
+  if (length > DISRUPTION_TEXT_LENGTH - 1) {
+    length = DISRUPTION_TEXT_LENGTH - 1;
+  }
+  strncpy(entry->code, code, 2);
+  entry->code[2] = '\0';
+  entry->status = status;
+  memcpy(entry->text, text, length);
+  entry->text[length] = '\0';
+  use_counter += 1;
+  entry->last_used = use_counter;
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+DisruptionEntry* find_entry(const char* code, uint32_t status) {
+  for (int e = 0; e < DISRUPTION_CACHE_SIZE; e += 1) {
+    if (entries[e].last_used > 0 && entries[e].status == status && strncmp(entries[e].code, code, 2) == 0) {
+      return &entries[e];
+    }
+  }
+  return NULL;
+}
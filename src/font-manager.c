@@ -0,0 +1,153 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "pebble_fonts.h"
+#include "font-manager.h"
+
+#define MAX_RESOURCES 12
+
+#define RESOURCE_FREE 0
+#define RESOURCE_FONT 1
+#define RESOURCE_BITMAP 2
+
+typedef struct {
+  uint32_t resource_id;
+  uint8_t type;
+  uint8_t refs;
+  bool loaded;
+  GFont font;
+  HeapBitmap bitmap;
+} ManagedResource;
+
+static ManagedResource* get_resource(uint32_t resource_id, uint8_t type);
+static ManagedResource* find_resource(uint32_t resource_id);
+static void unload_resource(ManagedResource* resource);
+
+static ManagedResource resources[MAX_RESOURCES];
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+GFont font_manager_get_font(uint32_t resource_id) {
+  ManagedResource* resource = get_resource(resource_id, RESOURCE_FONT);
+  if (! resource) {
+    return fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD);
+  }
+  if (! resource->loaded) {
+    resource->font = fonts_load_custom_font(resource_get_handle(resource_id));
+    resource->loaded = true;
+  }
+  return resource->font;
+}
+
+GBitmap* font_manager_get_bitmap(uint32_t resource_id) {
+  ManagedResource* resource = get_resource(resource_id, RESOURCE_BITMAP);
+  if (! resource) {
+    return NULL;
+  }
+  if (! resource->loaded) {
+    if (! heap_bitmap_init(&resource->bitmap, resource_id)) {
+      font_manager_purge();
+      if (! heap_bitmap_init(&resource->bitmap, resource_id)) {
+        memset(resource, 0, sizeof(ManagedResource));
+        return NULL;
+      }
+    }
+    resource->loaded = true;
+  }
+  return &resource->bitmap.bmp;
+}
+
+// A font is unloaded with its last reference, since a font that fails to
+// load for lack of memory can't be detected and retried the way a bitmap
+// can.
+void font_manager_release(uint32_t resource_id) {
+  ManagedResource* resource = find_resource(resource_id);
+  if (! resource || resource->refs == 0) {
+    return;
+  }
+  resource->refs -= 1;
+  if (resource->refs == 0 && resource->type == RESOURCE_FONT) {
+    unload_resource(resource);
+  }
+}
+
+void font_manager_purge() {
+  for (int r = 0; r < MAX_RESOURCES; r += 1) {
+    if (resources[r].type != RESOURCE_FREE && resources[r].refs == 0) {
+      unload_resource(&resources[r]);
+    }
+  }
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+// Finds or claims the table entry and takes a reference to it. A full
+// table is purged once before giving up.
+ManagedResource* get_resource(uint32_t resource_id, uint8_t type) {
+  ManagedResource* resource = find_resource(resource_id);
+  if (! resource) {
+    resource = find_resource(0);
+    if (! resource) {
+      font_manager_purge();
+      resource = find_resource(0);
+    }
+    if (! resource) {
+      return NULL;
+    }
+    resource->resource_id = resource_id;
+    resource->type = type;
+  }
+  resource->refs += 1;
+  return resource;
+}
+
+// Passing a resource id of 0 finds a free entry.
+ManagedResource* find_resource(uint32_t resource_id) {
+  for (int r = 0; r < MAX_RESOURCES; r += 1) {
+    bool free = resources[r].type == RESOURCE_FREE;
+    if (resource_id == 0 ? free : (! free && resources[r].resource_id == resource_id)) {
+      return &resources[r];
+    }
+  }
+  return NULL;
+}
+
+void unload_resource(ManagedResource* resource) {
+  if (resource->loaded) {
+    switch (resource->type) {
+      case RESOURCE_FONT:
+        fonts_unload_custom_font(resource->font);
+      break;
+      case RESOURCE_BITMAP:
+        heap_bitmap_deinit(&resource->bitmap);
+      break;
+    }
+  }
+  memset(resource, 0, sizeof(ManagedResource));
+}
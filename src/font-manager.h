@@ -0,0 +1,39 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef FONT_MANAGER_H
+#define FONT_MANAGER_H
+
+// Loads custom fonts and bitmaps on first use and shares them between
+// windows. Each get must be matched by a release. A font is unloaded when
+// its last reference is released, so it only lives while a window that
+// uses it is loaded. Released bitmaps stay loaded until a later load runs
+// out of memory, at which point everything unreferenced is unloaded and
+// the load is tried again.
+
+GFont font_manager_get_font(uint32_t resource_id);
+GBitmap* font_manager_get_bitmap(uint32_t resource_id);
+void font_manager_release(uint32_t resource_id);
+void font_manager_purge();
+
+#endif // FONT_MANAGER_H
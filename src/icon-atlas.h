@@ -0,0 +1,36 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Generated by tools/pack-icons.py. Do not edit.
+
+#ifndef ICON_ATLAS_H
+#define ICON_ATLAS_H
+
+// Position of each icon inside RESOURCE_ID_ICON_ATLAS.
+#define ICON_ATLAS_MENU_TUBE GRect(0, 0, 24, 28)
+#define ICON_ATLAS_MENU_BUS GRect(24, 0, 24, 28)
+#define ICON_ATLAS_MENU_THANKS GRect(48, 0, 24, 28)
+#define ICON_ATLAS_STATUS_OK GRect(72, 0, 12, 14)
+#define ICON_ATLAS_STATUS_PROBLEM GRect(84, 0, 12, 14)
+#define ICON_ATLAS_STATUS_UNKNOWN GRect(96, 0, 12, 14)
+
+#endif // ICON_ATLAS_H
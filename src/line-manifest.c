@@ -0,0 +1,283 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "config.h"
+#include "http.h"
+#include "request-scheduler.h"
+#include "status-store.h"
+#include "status-parser.h"
+#include "chunk-assembly.h"
+#include "line-manifest.h"
+
+// Manifests are a version number and a string of lines separated by '|',
+// each one a two letter code followed by the name, e.g. "BLBakerloo|CE...".
+// The full list is longer than one inbound message, so the server sends
+// the text in chunks, each with the version. In the status store the text
+// follows a header of the version and the text length, little-endian.
+// Whatever doesn't fit in that cookie is saved under a second key.
+
+#define KEY_VERSION 0
+
+#define MANIFEST_TEXT_SIZE 320
+#define MANIFEST_HEADER_SIZE 6
+
+typedef char manifest_fits_in_store[MANIFEST_HEADER_SIZE + MANIFEST_TEXT_SIZE <= 2 * STATUS_STORE_MAX_LENGTH ? 1 : -1];
+
+static bool apply_manifest(uint32_t version, const char* text, uint16_t length);
+static void save_manifest();
+static void manifest_loaded(const uint8_t* data, uint16_t length);
+static void manifest_rest_loaded(const uint8_t* data, uint16_t length);
+static void write_manifest_request(DictionaryIterator* body);
+static void manifest_http_success(int32_t cookie, int http_status, DictionaryIterator* received, void* context);
+static void manifest_http_failure(int32_t cookie, int http_status, void* context);
+
+static const ScheduledRequest manifest_request = {
+  .cookie = HTTP_LINE_MANIFEST,
+  .url = API_BASE_URL "/london-tube/v2/lines.php",
+  .write_body = write_manifest_request,
+  .success = manifest_http_success,
+  .failure = manifest_http_failure
+};
+
+static const char* default_manifest = "BLBakerloo|CECentral|CICircle|DIDistrict|DLDLR|HCH'smith & City|JLJubilee|MEMetropolitan|NONorthern|OVOverground|PIPicadilly|VIVictoria|WCWaterloo & City";
+
+static LineManifestHandler manifest_handler = NULL;
+static uint32_t fetching_version = 0;
+static uint32_t rejected_version = 0;
+
+// Fetched chunks are collected in the arena, which also holds the first
+// part of a saved manifest while the rest is loaded.
+static uint8_t manifest_arena[MANIFEST_TEXT_SIZE];
+static ChunkAssembly manifest_assembly;
+static uint32_t loading_version = 0;
+static uint16_t loading_length = 0;
+static uint16_t loading_first = 0;
+
+// The line table is kept as parallel arrays. Names are NUL terminated
+// strings inside the text buffer, which holds the manifest as received.
+static uint32_t manifest_version = 0;
+static uint8_t line_count = 0;
+static char line_codes[MANIFEST_MAX_LINES][2];
+static uint16_t line_name_offsets[MANIFEST_MAX_LINES];
+static char manifest_text[MANIFEST_TEXT_SIZE];
+static uint16_t manifest_length = 0;
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+void line_manifest_init(LineManifestHandler handler) {
+  manifest_handler = handler;
+  request_scheduler_register(&manifest_request);
+  chunk_assembly_init(&manifest_assembly, manifest_arena, sizeof(manifest_arena), NULL, NULL);
+  apply_manifest(0, default_manifest, strlen(default_manifest));
+  status_store_load(STATUS_STORE_MANIFEST, manifest_loaded);
+}
+
+// Called with the manifest version the server is using. Fetches the new
+// manifest unless it is already the one we have or is on its way, and
+// returns whether it is worth waiting for. A version whose fetch didn't
+// bring a usable manifest isn't fetched again until the server moves on
+// to another one.
+bool line_manifest_check(uint32_t version) {
+  if (version == manifest_version || version == rejected_version) {
+    return false;
+  }
+  if (version == fetching_version) {
+    return true;
+  }
+  fetching_version = version;
+  loading_version = 0;
+  chunk_assembly_reset(&manifest_assembly);
+  request_scheduler_send(HTTP_LINE_MANIFEST);
+  return true;
+}
+
+uint32_t line_manifest_version() {
+  return manifest_version;
+}
+
+uint8_t line_manifest_count() {
+  return line_count;
+}
+
+// The code is two letters and is not NUL terminated.
+const char* line_manifest_code(uint8_t line) {
+  return line_codes[line];
+}
+
+const char* line_manifest_name(uint8_t line) {
+  return manifest_text + line_name_offsets[line];
+}
+
+int line_manifest_find(const char* code) {
+  for (uint8_t l = 0; l < line_count; l += 1) {
+    if (line_codes[l][0] == code[0] && line_codes[l][1] == code[1]) {
+      return l;
+    }
+  }
+  return -1;
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+// Rejects the whole manifest, keeping the current one, if it has no lines,
+// too many lines or an entry too short to hold a code.
+bool apply_manifest(uint32_t version, const char* text, uint16_t length) {
+  if (length == 0 || length >= MANIFEST_TEXT_SIZE) {
+    return false;
+  }
+  char new_text[MANIFEST_TEXT_SIZE];
+  char new_codes[MANIFEST_MAX_LINES][2];
+  uint16_t new_offsets[MANIFEST_MAX_LINES];
+  uint8_t count = 0;
+
+  memcpy(new_text, text, length);
+  new_text[length] = '\0';
+
+  uint16_t start = 0;
+  for (uint16_t c = 0; c <= length; c += 1) {
+    if (new_text[c] != '|' && new_text[c] != '\0') {
+      continue;
+    }
+    if (count >= MANIFEST_MAX_LINES || c - start < 2) {
+      return false;
+    }
+    new_text[c] = '\0';
+    new_codes[count][0] = new_text[start];
+    new_codes[count][1] = new_text[start + 1];
+    new_offsets[count] = start + 2;
+    count += 1;
+    start = c + 1;
+  }
+
+  memcpy(manifest_text, new_text, length + 1);
+  memcpy(line_codes, new_codes, sizeof(new_codes));
+  memcpy(line_name_offsets, new_offsets, sizeof(new_offsets));
+  line_count = count;
+  manifest_length = length;
+  manifest_version = version;
+  return true;
+}
+
+// The separators have been replaced with NULs in manifest_text, so they
+// are put back while copying it out.
+void save_manifest() {
+  uint8_t data[MANIFEST_HEADER_SIZE + MANIFEST_TEXT_SIZE];
+  for (int b = 0; b < 4; b += 1) {
+    data[b] = (manifest_version >> (8 * b)) & 0xFF;
+  }
+  data[4] = manifest_length & 0xFF;
+  data[5] = manifest_length >> 8;
+  for (uint16_t c = 0; c < manifest_length; c += 1) {
+    data[MANIFEST_HEADER_SIZE + c] = manifest_text[c] == '\0' ? '|' : manifest_text[c];
+  }
+  uint16_t size = MANIFEST_HEADER_SIZE + manifest_length;
+  uint16_t first = size < STATUS_STORE_MAX_LENGTH ? size : STATUS_STORE_MAX_LENGTH;
+  status_store_save(STATUS_STORE_MANIFEST, data, first);
+  if (size > first) {
+    status_store_save(STATUS_STORE_MANIFEST_REST, data + first, size - first);
+  }
+}
+
+// A newer manifest may already have arrived from the server, or be on its
+// way, in which case the saved one is ignored.
+void manifest_loaded(const uint8_t* data, uint16_t length) {
+  if (length < MANIFEST_HEADER_SIZE || manifest_version != 0 || fetching_version != 0) {
+    return;
+  }
+  uint32_t version = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+  uint16_t text_length = data[4] | (data[5] << 8);
+  uint16_t first = length - MANIFEST_HEADER_SIZE;
+  if (text_length > MANIFEST_TEXT_SIZE || first > text_length) {
+    return;
+  }
+  memcpy(manifest_arena, data + MANIFEST_HEADER_SIZE, first);
+  if (first < text_length) {
+    loading_version = version;
+    loading_length = text_length;
+    loading_first = first;
+    status_store_load(STATUS_STORE_MANIFEST_REST, manifest_rest_loaded);
+    return;
+  }
+  if (apply_manifest(version, (const char*)manifest_arena, text_length) && manifest_handler) {
+    manifest_handler(true);
+  }
+}
+
+void manifest_rest_loaded(const uint8_t* data, uint16_t length) {
+  uint32_t version = loading_version;
+  loading_version = 0;
+  if (version == 0 || manifest_version != 0 || length != loading_length - loading_first) {
+    return;
+  }
+  memcpy(manifest_arena + loading_first, data, length);
+  if (apply_manifest(version, (const char*)manifest_arena, loading_length) && manifest_handler) {
+    manifest_handler(true);
+  }
+}
+
+void write_manifest_request(DictionaryIterator* body) {
+  dict_write_uint32(body, KEY_VERSION, manifest_version);
+  chunk_assembly_write_request(&manifest_assembly, body);
+}
+
+// Asks for the next chunk until the text is complete. The same version
+// again is not a change. If the fetch ends without the version that was
+// asked for, that version is rejected.
+void manifest_http_success(int32_t cookie, int http_status, DictionaryIterator* received, void* context) {
+  Tuple* tuple_version = dict_find(received, KEY_VERSION);
+  uint32_t version = 0;
+  ChunkResult result = CHUNK_ERROR;
+  if (tuple_version && status_parser_read_uint(tuple_version, &version) == STATUS_PARSE_OK) {
+    result = chunk_assembly_add(&manifest_assembly, received);
+  }
+  if (result == CHUNK_INCOMPLETE) {
+    request_scheduler_send(HTTP_LINE_MANIFEST);
+    return;
+  }
+  bool changed = result == CHUNK_COMPLETE && version != manifest_version &&
+    apply_manifest(version, (const char*)manifest_arena, manifest_assembly.total);
+  if (changed) {
+    save_manifest();
+  }
+  if (manifest_version != fetching_version) {
+    rejected_version = fetching_version;
+  }
+  fetching_version = 0;
+  chunk_assembly_reset(&manifest_assembly);
+  if (manifest_handler) {
+    manifest_handler(changed);
+  }
+}
+
+void manifest_http_failure(int32_t cookie, int http_status, void* context) {
+  fetching_version = 0;
+  chunk_assembly_reset(&manifest_assembly);
+  if (manifest_handler) {
+    manifest_handler(false);
+  }
+}
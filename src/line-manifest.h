@@ -0,0 +1,47 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef LINE_MANIFEST_H
+#define LINE_MANIFEST_H
+
+// The list of lines the app shows, with their codes and names. A built in
+// copy is used until the server sends a newer one, which is then cached in
+// the status store. Lines are referred to by their index in the manifest,
+// which is also how the server refers to them in status responses.
+
+#define HTTP_LINE_MANIFEST 8830
+
+#define MANIFEST_MAX_LINES 24
+
+// Called once a cached or fetched manifest has been looked at, with whether
+// the lines changed. A failed fetch is reported as unchanged.
+typedef void (*LineManifestHandler)(bool changed);
+
+void line_manifest_init(LineManifestHandler handler);
+bool line_manifest_check(uint32_t version);
+uint32_t line_manifest_version();
+uint8_t line_manifest_count();
+const char* line_manifest_code(uint8_t line);
+const char* line_manifest_name(uint8_t line);
+int line_manifest_find(const char* code);
+
+#endif // LINE_MANIFEST_H
@@ -0,0 +1,268 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "config.h"
+#include "http.h"
+#include "request-scheduler.h"
+#include "status-store.h"
+#include "outbox.h"
+
+#define OUTBOX_MAX_ITEMS 3
+#define OUTBOX_MAX_ENDPOINTS 3
+#define OUTBOX_BODY_SIZE 48
+
+typedef struct {
+  int32_t cookie;
+  uint16_t length;
+  bool sent;
+  uint8_t body[OUTBOX_BODY_SIZE];
+} OutboxItem;
+
+typedef struct {
+  uint8_t count;
+  OutboxItem items[OUTBOX_MAX_ITEMS];
+} Outbox;
+
+typedef struct {
+  int32_t cookie;
+  const char* url;
+} OutboxEndpoint;
+
+static void write_outbox_request(DictionaryIterator* body);
+static void outbox_success(int32_t cookie, int http_status, DictionaryIterator* received, void* context);
+static void outbox_failure(int32_t cookie, int http_status, void* context);
+static void outbox_loaded(const uint8_t* data, uint16_t length);
+static void remove_item(uint8_t item);
+static int find_item(int32_t cookie);
+static void save_outbox();
+static void update_url();
+
+static Outbox outbox;
+static bool items_left_out = false;
+static OutboxEndpoint endpoints[OUTBOX_MAX_ENDPOINTS];
+static uint8_t num_endpoints = 0;
+static bool url_is_endpoint = false;
+static bool sending_alone = false;
+
+// The URL is changed by update_url whenever the items waiting change.
+static ScheduledRequest outbox_request = {
+  .cookie = HTTP_OUTBOX,
+  .url = BATCH_URL,
+  .write_body = write_outbox_request,
+  .success = outbox_success,
+  .failure = outbox_failure,
+  .background = true
+};
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+void outbox_init() {
+  request_scheduler_register(&outbox_request);
+  status_store_load(STATUS_STORE_OUTBOX, outbox_loaded);
+}
+
+// Saved items can arrive before anything is added, so the endpoints are
+// registered when the app starts rather than with each item.
+bool outbox_register(int32_t cookie, const char* url) {
+  if (num_endpoints >= OUTBOX_MAX_ENDPOINTS) {
+    return false;
+  }
+  endpoints[num_endpoints].cookie = cookie;
+  endpoints[num_endpoints].url = url;
+  num_endpoints += 1;
+  update_url();
+  return true;
+}
+
+// The body is written straight away, so the writer doesn't need to keep
+// its state around. A newer request for the same cookie replaces the old
+// one, even if the old one is already on its way.
+void outbox_add(int32_t cookie, RequestBodyWriter write_body) {
+  int item = find_item(cookie);
+  if (item < 0) {
+    if (outbox.count >= OUTBOX_MAX_ITEMS) {
+      return;
+    }
+    item = outbox.count;
+    outbox.count += 1;
+  }
+  OutboxItem* entry = &outbox.items[item];
+  DictionaryIterator body;
+  dict_write_begin(&body, entry->body, OUTBOX_BODY_SIZE);
+  if (write_body) {
+    write_body(&body);
+  }
+  entry->length = dict_write_end(&body);
+  entry->cookie = cookie;
+  entry->sent = false;
+  update_url();
+  save_outbox();
+  outbox_flush();
+}
+
+// Called whenever another request gets a response, since the phone is
+// clearly reachable. A request waiting to retry after a failure is sent
+// again now, but not one waiting because the server left items out.
+void outbox_flush() {
+  if (outbox.count == 0) {
+    return;
+  }
+  switch (request_scheduler_state(HTTP_OUTBOX)) {
+    case REQUEST_QUEUED:
+    case REQUEST_IN_FLIGHT:
+    break;
+    case REQUEST_RETRY_WAIT:
+      if (! items_left_out) {
+        request_scheduler_send(HTTP_OUTBOX);
+      }
+    break;
+    default:
+      request_scheduler_send(HTTP_OUTBOX);
+    break;
+  }
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+// A lone item is written as it is, for its own endpoint.
+void write_outbox_request(DictionaryIterator* body) {
+  sending_alone = url_is_endpoint;
+  if (sending_alone) {
+    OutboxItem* item = &outbox.items[0];
+    request_scheduler_write_dict(body, item->body, item->length);
+    item->sent = true;
+    return;
+  }
+  for (uint8_t i = 0; i < outbox.count; i += 1) {
+    OutboxItem* item = &outbox.items[i];
+    request_scheduler_write_part(body, i, item->cookie, item->body, item->length);
+    item->sent = true;
+  }
+}
+
+// Items the server answered are done, and a lone item is done once its
+// endpoint replies at all. Anything a batch left out is sent again after
+// the scheduler's retry backoff.
+void outbox_success(int32_t cookie, int http_status, DictionaryIterator* received, void* context) {
+  bool changed = false;
+  Tuple* tuple = sending_alone ? NULL : dict_read_first(received);
+  if (sending_alone && outbox.count > 0 && outbox.items[0].sent) {
+    remove_item(0);
+    changed = true;
+  }
+  while (tuple) {
+    if ((tuple->key & 0xFFFF) == BATCH_KEY_COOKIE) {
+      int item = find_item(tuple->value->int32);
+      if (item >= 0 && outbox.items[item].sent) {
+        remove_item(item);
+        changed = true;
+      }
+    }
+    tuple = dict_read_next(received);
+  }
+  if (changed) {
+    save_outbox();
+  }
+  items_left_out = false;
+  for (uint8_t i = 0; i < outbox.count; i += 1) {
+    items_left_out = items_left_out || outbox.items[i].sent;
+  }
+  if (items_left_out) {
+    request_scheduler_retry(HTTP_OUTBOX, http_status);
+  }
+}
+
+// Items the server still left out after every retry are never going to be
+// accepted, so they are dropped. After a plain failure everything is kept
+// for the next flush.
+void outbox_failure(int32_t cookie, int http_status, void* context) {
+  if (! items_left_out) {
+    return;
+  }
+  items_left_out = false;
+  for (int i = outbox.count - 1; i >= 0; i -= 1) {
+    if (outbox.items[i].sent) {
+      remove_item(i);
+    }
+  }
+  save_outbox();
+}
+
+// Anything added before the saved items arrived is newer, so it wins.
+void outbox_loaded(const uint8_t* data, uint16_t length) {
+  if (length != sizeof(Outbox)) {
+    return;
+  }
+  Outbox saved;
+  memcpy(&saved, data, sizeof(saved));
+  for (uint8_t i = 0; i < saved.count && i < OUTBOX_MAX_ITEMS; i += 1) {
+    if (saved.items[i].length > OUTBOX_BODY_SIZE || find_item(saved.items[i].cookie) >= 0 || outbox.count >= OUTBOX_MAX_ITEMS) {
+      continue;
+    }
+    outbox.items[outbox.count] = saved.items[i];
+    outbox.items[outbox.count].sent = false;
+    outbox.count += 1;
+  }
+  update_url();
+  outbox_flush();
+}
+
+void remove_item(uint8_t item) {
+  outbox.count -= 1;
+  memmove(&outbox.items[item], &outbox.items[item + 1], (outbox.count - item) * sizeof(OutboxItem));
+  update_url();
+}
+
+int find_item(int32_t cookie) {
+  for (uint8_t i = 0; i < outbox.count; i += 1) {
+    if (outbox.items[i].cookie == cookie) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void save_outbox() {
+  status_store_save(STATUS_STORE_OUTBOX, (uint8_t*)&outbox, sizeof(outbox));
+}
+
+// Batches only when more than one item is waiting, or for an item whose
+// cookie has no endpoint of its own.
+void update_url() {
+  outbox_request.url = BATCH_URL;
+  url_is_endpoint = false;
+  if (outbox.count != 1) {
+    return;
+  }
+  for (uint8_t e = 0; e < num_endpoints; e += 1) {
+    if (endpoints[e].cookie == outbox.items[0].cookie) {
+      outbox_request.url = endpoints[e].url;
+      url_is_endpoint = true;
+    }
+  }
+}
@@ -0,0 +1,522 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "config.h"
+#include "http.h"
+#include "request-scheduler.h"
+#include "diagnostics.h"
+#include "status-store.h"
+
+#define MAX_REQUESTS 6
+#define MAX_ATTEMPTS 5
+#define FLUSH_DELAY_MS 250
+#define TIMEOUT_MS 15000
+#define RETRY_BASE_MS 2000
+#define RETRY_MAX_MS 30000
+#define TIMER_COOKIE 0x5C4ED
+
+#define HTTP_STATUS_TIMEOUT 408
+#define NO_TIMER 0
+
+#define BATCH_PART_BUFFER_SIZE 256
+
+typedef struct {
+  const ScheduledRequest* request;
+  RequestState state;
+  uint8_t attempts;
+  bool batched;
+  bool unbatchable;
+  AppTimerHandle timer;
+  uint32_t sent_at;
+} RequestSlot;
+
+static void flush();
+static void flush_background();
+static void send_direct(RequestSlot* slot);
+static void send_batch(RequestSlot** parts, int num_parts);
+static void write_batch_part(DictionaryIterator* body, int part, RequestSlot* slot);
+static void split_batch(DictionaryIterator* received, int http_status, void* context);
+static void copy_dict(DictionaryIterator* body, uint32_t key_base, const uint8_t* data, uint16_t length);
+static void copy_tuple(DictionaryIterator* iter, uint32_t key, Tuple* tuple);
+static void request_sent(RequestSlot* slot, bool batched);
+static void request_done(RequestSlot* slot);
+static void request_failed(RequestSlot* slot, int http_status, void* context);
+static void request_unbatched(RequestSlot* slot);
+static void set_slot_state(RequestSlot* slot, RequestState state);
+static void cancel_slot_timer(RequestSlot* slot);
+static RequestSlot* get_slot(int32_t cookie);
+static RequestSlot* get_slot_by_timer(AppTimerHandle handle);
+static bool batch_in_flight();
+static bool store_busy();
+
+static AppContextRef app_ctx;
+static RequestSlot slots[MAX_REQUESTS];
+static AppTimerHandle flush_timer = NO_TIMER;
+static uint8_t batch_part_buffer[BATCH_PART_BUFFER_SIZE];
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+void request_scheduler_init(AppContextRef ctx) {
+  app_ctx = ctx;
+}
+
+// Returns false if every slot is taken. Sending the request would then do
+// nothing, so the failure is counted where the diagnostics screen shows
+// it; raise MAX_REQUESTS if it is ever non-zero.
+bool request_scheduler_register(const ScheduledRequest* request) {
+  RequestSlot* slot = get_slot(request->cookie);
+  if (! slot) {
+    slot = get_slot(0);
+  }
+  if (! slot) {
+    diagnostics_count(DIAG_UNREGISTERED);
+    return false;
+  }
+  slot->request = request;
+  return true;
+}
+
+// Queues the request unless it is already queued or in flight. Anything
+// queued within FLUSH_DELAY_MS of it goes out in the same round trip. A
+// request that is waiting to retry is queued straight away instead.
+void request_scheduler_send(int32_t cookie) {
+  RequestSlot* slot = get_slot(cookie);
+  if (! slot) {
+    diagnostics_count(DIAG_UNREGISTERED);
+    return;
+  }
+  if (slot->state == REQUEST_QUEUED || slot->state == REQUEST_IN_FLIGHT) {
+    return;
+  }
+  if (slot->state != REQUEST_RETRY_WAIT) {
+    slot->attempts = 0;
+  }
+  cancel_slot_timer(slot);
+  set_slot_state(slot, REQUEST_QUEUED);
+  if (flush_timer == NO_TIMER) {
+    flush_timer = app_timer_send_event(app_ctx, FLUSH_DELAY_MS, TIMER_COOKIE);
+  }
+}
+
+void request_scheduler_success(int32_t cookie, int http_status, DictionaryIterator* received, void* context) {
+  diagnostics_record(DIAG_RESPONSE_BYTES, diagnostics_dict_size(received));
+  if (cookie == HTTP_BATCH) {
+    split_batch(received, http_status, context);
+    flush();
+    return;
+  }
+  RequestSlot* slot = get_slot(cookie);
+  if (! slot) {
+    return;
+  }
+  request_done(slot);
+  if (slot->request->success) {
+    slot->request->success(cookie, http_status, received, context);
+  }
+  flush_background();
+}
+
+// A 404 or 5xx for a batch means the host can't take batches, so the parts
+// are sent on their own instead of failing together.
+void request_scheduler_failure(int32_t cookie, int http_status, void* context) {
+  if (cookie == HTTP_BATCH) {
+    bool no_batches = http_status == 404 || http_status >= 500;
+    for (int s = 0; s < MAX_REQUESTS; s += 1) {
+      if (slots[s].state != REQUEST_IN_FLIGHT || ! slots[s].batched) {
+        continue;
+      }
+      if (no_batches) {
+        request_unbatched(&slots[s]);
+      }
+      else {
+        request_failed(&slots[s], http_status, context);
+      }
+    }
+    flush();
+    return;
+  }
+  RequestSlot* slot = get_slot(cookie);
+  if (! slot || slot->state != REQUEST_IN_FLIGHT) {
+    return;
+  }
+  request_failed(slot, http_status, context);
+  flush_background();
+}
+
+// For a success handler whose response left part of the request undone,
+// the way a batch part the server left out is treated: the request waits
+// and is sent again, and only fails once MAX_ATTEMPTS responses in a row
+// have come back incomplete.
+void request_scheduler_retry(int32_t cookie, int http_status) {
+  RequestSlot* slot = get_slot(cookie);
+  if (! slot || slot->state != REQUEST_IDLE) {
+    return;
+  }
+  request_failed(slot, http_status, NULL);
+}
+
+// Returns true if the timer belonged to the scheduler.
+bool request_scheduler_timer(AppTimerHandle handle) {
+  if (handle != NO_TIMER && handle == flush_timer) {
+    flush_timer = NO_TIMER;
+    flush();
+    return true;
+  }
+  RequestSlot* slot = get_slot_by_timer(handle);
+  if (! slot) {
+    return false;
+  }
+  slot->timer = NO_TIMER;
+  switch (slot->state) {
+    case REQUEST_IN_FLIGHT:
+      request_failed(slot, HTTP_STATUS_TIMEOUT, NULL);
+      flush();
+    break;
+    case REQUEST_RETRY_WAIT:
+      request_scheduler_send(slot->request->cookie);
+    break;
+    default:
+    break;
+  }
+  return true;
+}
+
+RequestState request_scheduler_state(int32_t cookie) {
+  RequestSlot* slot = get_slot(cookie);
+  return slot ? slot->state : REQUEST_IDLE;
+}
+
+uint8_t request_scheduler_attempts(int32_t cookie) {
+  RequestSlot* slot = get_slot(cookie);
+  return slot ? slot->attempts : 0;
+}
+
+// Copies a dictionary written by the request into the batch under the
+// part's keys.
+void request_scheduler_write_part(DictionaryIterator* body, int part, int32_t cookie, const uint8_t* data, uint16_t length) {
+  dict_write_int32(body, BATCH_KEY(part, BATCH_KEY_COOKIE), cookie);
+  copy_dict(body, BATCH_KEY(part, 0), data, length);
+}
+
+// Copies a dictionary written by the request into the body unchanged.
+void request_scheduler_write_dict(DictionaryIterator* body, const uint8_t* data, uint16_t length) {
+  copy_dict(body, 0, data, length);
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+// A single queued request goes to its own URL, several go as one batch.
+// Only one batch is in flight at a time, since the response is matched
+// to it by cookie alone; anything queued meanwhile waits for it to finish.
+// Requests that can't be batched go first, one per flush.
+void flush() {
+  if (batch_in_flight() || store_busy()) {
+    return;
+  }
+  RequestSlot* parts[MAX_REQUESTS];
+  int num_parts = 0;
+  RequestSlot* unbatchable = NULL;
+  for (int s = 0; s < MAX_REQUESTS; s += 1) {
+    if (slots[s].state != REQUEST_QUEUED || slots[s].request->background) {
+      continue;
+    }
+    if (slots[s].unbatchable && ! unbatchable) {
+      unbatchable = &slots[s];
+    }
+    else {
+      parts[num_parts] = &slots[s];
+      num_parts += 1;
+    }
+  }
+  if (unbatchable) {
+    send_direct(unbatchable);
+    if (num_parts > 0 && flush_timer == NO_TIMER) {
+      flush_timer = app_timer_send_event(app_ctx, FLUSH_DELAY_MS, TIMER_COOKIE);
+    }
+  }
+  else if (num_parts == 1) {
+    send_direct(parts[0]);
+  }
+  else if (num_parts > 1) {
+    send_batch(parts, num_parts);
+  }
+  else {
+    flush_background();
+  }
+}
+
+// Background requests are never batched and only go out, one at a time,
+// once nothing else is queued or waiting for a response.
+void flush_background() {
+  if (store_busy()) {
+    return;
+  }
+  RequestSlot* next = NULL;
+  for (int s = 0; s < MAX_REQUESTS; s += 1) {
+    if (slots[s].state == REQUEST_IN_FLIGHT) {
+      return;
+    }
+    if (slots[s].state == REQUEST_QUEUED) {
+      if (! slots[s].request->background) {
+        return;
+      }
+      if (! next) {
+        next = &slots[s];
+      }
+    }
+  }
+  if (next) {
+    send_direct(next);
+  }
+}
+
+void send_direct(RequestSlot* slot) {
+  const ScheduledRequest* request = slot->request;
+  DictionaryIterator* body;
+  HTTPResult result = http_out_get(request->url, request->cookie, &body);
+  if (result == HTTP_OK) {
+    if (request->write_body) {
+      request->write_body(body);
+    }
+    diagnostics_record(DIAG_REQUEST_BYTES, diagnostics_dict_size(body));
+    result = http_out_send();
+  }
+  request_sent(slot, false);
+  if (result != HTTP_OK) {
+    request_failed(slot, result, NULL);
+  }
+}
+
+void send_batch(RequestSlot** parts, int num_parts) {
+  DictionaryIterator* body;
+  HTTPResult result = http_out_get(BATCH_URL, HTTP_BATCH, &body);
+  if (result == HTTP_OK) {
+    for (int p = 0; p < num_parts; p += 1) {
+      write_batch_part(body, p, parts[p]);
+    }
+    diagnostics_record(DIAG_REQUEST_BYTES, diagnostics_dict_size(body));
+    result = http_out_send();
+  }
+  for (int p = 0; p < num_parts; p += 1) {
+    request_sent(parts[p], true);
+    if (result != HTTP_OK) {
+      request_failed(parts[p], result, NULL);
+    }
+  }
+}
+
+// Lets the request write its body as normal into a scratch dictionary,
+// then copies each tuple into the batch under the part's keys.
+void write_batch_part(DictionaryIterator* body, int part, RequestSlot* slot) {
+  uint32_t size = 0;
+  if (slot->request->write_body) {
+    DictionaryIterator part_iter;
+    dict_write_begin(&part_iter, batch_part_buffer, sizeof(batch_part_buffer));
+    slot->request->write_body(&part_iter);
+    size = dict_write_end(&part_iter);
+  }
+  request_scheduler_write_part(body, part, slot->request->cookie, batch_part_buffer, size);
+}
+
+// Rebuilds each part's response with its original keys and passes it to
+// that request's success handler. Parts the server left out have failed.
+void split_batch(DictionaryIterator* received, int http_status, void* context) {
+  int32_t part_cookies[MAX_REQUESTS] = { 0 };
+  Tuple* tuple = dict_read_first(received);
+  while (tuple) {
+    if ((tuple->key & 0xFFFF) == BATCH_KEY_COOKIE && BATCH_PART(tuple->key) < MAX_REQUESTS) {
+      part_cookies[BATCH_PART(tuple->key)] = tuple->value->int32;
+    }
+    tuple = dict_read_next(received);
+  }
+
+  for (int p = 0; p < MAX_REQUESTS; p += 1) {
+    RequestSlot* slot = part_cookies[p] ? get_slot(part_cookies[p]) : NULL;
+    if (! slot || slot->state != REQUEST_IN_FLIGHT || ! slot->batched) {
+      continue;
+    }
+    DictionaryIterator part_iter;
+    dict_write_begin(&part_iter, batch_part_buffer, sizeof(batch_part_buffer));
+    tuple = dict_read_first(received);
+    while (tuple) {
+      if ((tuple->key & 0xFFFF) != BATCH_KEY_COOKIE && BATCH_PART(tuple->key) == (uint32_t)p) {
+        copy_tuple(&part_iter, tuple->key & 0xFFFF, tuple);
+      }
+      tuple = dict_read_next(received);
+    }
+    uint32_t size = dict_write_end(&part_iter);
+    dict_read_begin_from_buffer(&part_iter, batch_part_buffer, size);
+
+    request_done(slot);
+    if (slot->request->success) {
+      slot->request->success(slot->request->cookie, http_status, &part_iter, context);
+    }
+  }
+
+  for (int s = 0; s < MAX_REQUESTS; s += 1) {
+    if (slots[s].state == REQUEST_IN_FLIGHT && slots[s].batched) {
+      request_failed(&slots[s], http_status, context);
+    }
+  }
+}
+
+void copy_dict(DictionaryIterator* body, uint32_t key_base, const uint8_t* data, uint16_t length) {
+  if (length == 0) {
+    return;
+  }
+  DictionaryIterator iter;
+  Tuple* tuple = dict_read_begin_from_buffer(&iter, data, length);
+  while (tuple) {
+    copy_tuple(body, key_base | tuple->key, tuple);
+    tuple = dict_read_next(&iter);
+  }
+}
+
+void copy_tuple(DictionaryIterator* iter, uint32_t key, Tuple* tuple) {
+  switch (tuple->type) {
+    case TUPLE_BYTE_ARRAY:
+      dict_write_data(iter, key, tuple->value->data, tuple->length);
+    break;
+    case TUPLE_CSTRING:
+      dict_write_cstring(iter, key, tuple->value->cstring);
+    break;
+    case TUPLE_UINT:
+    case TUPLE_INT:
+      dict_write_int(iter, key, tuple->value->data, tuple->length, tuple->type == TUPLE_INT);
+    break;
+  }
+}
+
+void request_sent(RequestSlot* slot, bool batched) {
+  diagnostics_count(DIAG_REQUESTS);
+  slot->sent_at = diagnostics_now();
+  slot->attempts += 1;
+  slot->batched = batched;
+  set_slot_state(slot, REQUEST_IN_FLIGHT);
+  slot->timer = app_timer_send_event(app_ctx, TIMEOUT_MS, TIMER_COOKIE);
+}
+
+void request_done(RequestSlot* slot) {
+  diagnostics_count(DIAG_RESPONSES);
+  diagnostics_record(DIAG_LATENCY, diagnostics_since(slot->sent_at));
+  cancel_slot_timer(slot);
+  slot->batched = false;
+  set_slot_state(slot, REQUEST_IDLE);
+}
+
+// Waits 2s, 4s, 8s... (capped at RETRY_MAX_MS) between attempts and only
+// reports the failure once MAX_ATTEMPTS have been made.
+void request_failed(RequestSlot* slot, int http_status, void* context) {
+  diagnostics_count(DIAG_FAILURES);
+  cancel_slot_timer(slot);
+  slot->batched = false;
+  if (slot->attempts >= MAX_ATTEMPTS) {
+    slot->attempts = 0;
+    set_slot_state(slot, REQUEST_FAILED);
+    if (slot->request->failure) {
+      slot->request->failure(slot->request->cookie, http_status, context);
+    }
+    return;
+  }
+  uint32_t delay = RETRY_BASE_MS << (slot->attempts - 1);
+  if (delay > RETRY_MAX_MS) {
+    delay = RETRY_MAX_MS;
+  }
+  slot->timer = app_timer_send_event(app_ctx, delay, TIMER_COOKIE);
+  set_slot_state(slot, REQUEST_RETRY_WAIT);
+}
+
+// The batch's failure isn't the request's, so it gets its attempt back and
+// is queued again to be sent on its own, now and from then on.
+void request_unbatched(RequestSlot* slot) {
+  cancel_slot_timer(slot);
+  slot->batched = false;
+  slot->unbatchable = true;
+  slot->attempts -= 1;
+  set_slot_state(slot, REQUEST_QUEUED);
+}
+
+void set_slot_state(RequestSlot* slot, RequestState state) {
+  slot->state = state;
+  if (slot->request->state_changed) {
+    slot->request->state_changed(slot->request->cookie, state);
+  }
+}
+
+void cancel_slot_timer(RequestSlot* slot) {
+  if (slot->timer != NO_TIMER) {
+    app_timer_cancel_event(app_ctx, slot->timer);
+    slot->timer = NO_TIMER;
+  }
+}
+
+// Passing a cookie of 0 finds a free slot.
+RequestSlot* get_slot(int32_t cookie) {
+  for (int s = 0; s < MAX_REQUESTS; s += 1) {
+    int32_t slot_cookie = slots[s].request ? slots[s].request->cookie : 0;
+    if (slot_cookie == cookie) {
+      return &slots[s];
+    }
+  }
+  return NULL;
+}
+
+RequestSlot* get_slot_by_timer(AppTimerHandle handle) {
+  if (handle == NO_TIMER) {
+    return NULL;
+  }
+  for (int s = 0; s < MAX_REQUESTS; s += 1) {
+    if (slots[s].timer == handle) {
+      return &slots[s];
+    }
+  }
+  return NULL;
+}
+
+bool batch_in_flight() {
+  for (int s = 0; s < MAX_REQUESTS; s += 1) {
+    if (slots[s].state == REQUEST_IN_FLIGHT && slots[s].batched) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The cookie store shares httpebble's one outbound message, and a request
+// sent while a save or load waits for its answer would be refused. The
+// flush is tried again a little later instead.
+bool store_busy() {
+  if (! status_store_busy()) {
+    return false;
+  }
+  if (flush_timer == NO_TIMER) {
+    flush_timer = app_timer_send_event(app_ctx, FLUSH_DELAY_MS, TIMER_COOKIE);
+  }
+  return true;
+}
@@ -0,0 +1,70 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef REQUEST_SCHEDULER_H
+#define REQUEST_SCHEDULER_H
+
+#define HTTP_BATCH 8827
+
+// In a batch every key of part p is moved into its own block of keys, and
+// the block's BATCH_KEY_COOKIE key tells the server which endpoint it is
+// for. The server answers using the same blocks.
+#define BATCH_URL API_BASE_URL "/batch/v1/batch.php"
+#define BATCH_KEY(part, key) ((((part) + 1) << 16) | (key))
+#define BATCH_KEY_COOKIE 0xFFFF
+#define BATCH_PART(key) (((key) >> 16) - 1)
+
+typedef enum {
+  REQUEST_IDLE,
+  REQUEST_QUEUED,
+  REQUEST_IN_FLIGHT,
+  REQUEST_RETRY_WAIT,
+  REQUEST_FAILED
+} RequestState;
+
+typedef void (*RequestBodyWriter)(DictionaryIterator* body);
+typedef void (*RequestStateHandler)(int32_t cookie, RequestState state);
+
+typedef struct {
+  int32_t cookie;
+  const char* url;
+  RequestBodyWriter write_body;
+  HTTPRequestSucceededHandler success;
+  HTTPRequestFailedHandler failure;
+  RequestStateHandler state_changed;
+  bool background;
+} ScheduledRequest;
+
+void request_scheduler_init(AppContextRef ctx);
+bool request_scheduler_register(const ScheduledRequest* request);
+void request_scheduler_send(int32_t cookie);
+void request_scheduler_success(int32_t cookie, int http_status, DictionaryIterator* received, void* context);
+void request_scheduler_failure(int32_t cookie, int http_status, void* context);
+void request_scheduler_retry(int32_t cookie, int http_status);
+bool request_scheduler_timer(AppTimerHandle handle);
+RequestState request_scheduler_state(int32_t cookie);
+uint8_t request_scheduler_attempts(int32_t cookie);
+void request_scheduler_write_part(DictionaryIterator* body, int part, int32_t cookie, const uint8_t* data, uint16_t length);
+void request_scheduler_write_dict(DictionaryIterator* body, const uint8_t* data, uint16_t length);
+
+#endif // REQUEST_SCHEDULER_H
@@ -23,14 +23,28 @@
 #include "pebble_os.h"
 #include "pebble_app.h"
 #include "pebble_fonts.h"
+#include "config.h"
 #include "http.h"
 #include "smallstone.h"
+#include "request-scheduler.h"
+#include "outbox.h"
 
 #define HTTP_COOKIE_THANKS 8825
+#define THANKS_URL API_BASE_URL "/thanks/v1/thanks.php"
+
+static void write_thanks_request(DictionaryIterator* body);
+
+static char* thanks_app;
+static char thanks_version[10];
 
 Window window_thanks;
 TextLayer layer_text_thanks;
 ScrollLayer layer_scroll_thanks;
+static bool thanks_window_created = false;
+
+void thanks_init() {
+  outbox_register(HTTP_COOKIE_THANKS, THANKS_URL);
+}
 
 void create_thanks_window() {
 
@@ -59,21 +73,27 @@ void create_thanks_window() {
   text_layer_set_size(&layer_text_thanks, max_size);
   scroll_layer_add_child(&layer_scroll_thanks, &layer_text_thanks.layer);
   scroll_layer_set_content_size(&layer_scroll_thanks, GSize(144, max_size.h + vert_scroll_text_padding));
+  thanks_window_created = true;
 }
 
+// The thanks window, and the text measuring it needs, is only built the
+// first time it is shown.
 void show_thanks_window() {
+  if (! thanks_window_created) {
+    create_thanks_window();
+  }
   window_stack_push(&window_thanks, true);
 }
 
+// Goes through the outbox, so it is delivered even if the phone can't be
+// reached right now. Thanking again before it has gone only sends it once.
 void send_thanks(char* app, int ver_maj, int ver_min) {
-  DictionaryIterator* body;
-  HTTPResult result = http_out_get("http://api.pblweb.com/thanks/v1/thanks.php", HTTP_COOKIE_THANKS, &body);
-  if (result != HTTP_OK) {
-    return;
-  }
-  dict_write_cstring(body, 0, app);
-  char version_str[10];
-  snprintf(version_str, sizeof(version_str), "%d-%d", ver_maj, ver_min);
-  dict_write_cstring(body, 1, version_str);
-  result = http_out_send();
-}
\ No newline at end of file
+  thanks_app = app;
+  snprintf(thanks_version, sizeof(thanks_version), "%d-%d", ver_maj, ver_min);
+  outbox_add(HTTP_COOKIE_THANKS, write_thanks_request);
+}
+
+void write_thanks_request(DictionaryIterator* body) {
+  dict_write_cstring(body, 0, thanks_app);
+  dict_write_cstring(body, 1, thanks_version);
+}
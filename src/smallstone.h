@@ -23,6 +23,7 @@
 #ifndef SMALLSTONE_H
 #define SMALLSTONE_H
 
+void thanks_init();
 void send_thanks(char* app, int ver_maj, int ver_min);
 void create_thanks_window();
 void show_thanks_window();
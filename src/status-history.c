@@ -0,0 +1,171 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "line-manifest.h"
+#include "status-store.h"
+#include "status-history.h"
+
+// Status words are stored in 12 bits, enough for every flag in
+// tube-statuses.def. Five entries of 24 lines come to 208 bytes with
+// padding, which fits in a single cookie. Both limits are checked below.
+#define HISTORY_ENTRIES 5
+#define HISTORY_STATUS_BITS 12
+#define HISTORY_STATUS_MASK ((1 << HISTORY_STATUS_BITS) - 1)
+#define HISTORY_PACKED_SIZE ((MANIFEST_MAX_LINES * HISTORY_STATUS_BITS + 7) / 8)
+
+#define MINUTES_PER_DAY (24 * 60)
+#define MINUTES_PER_YEAR (366 * MINUTES_PER_DAY)
+
+typedef struct {
+  uint32_t minute;
+  uint8_t packed[HISTORY_PACKED_SIZE];
+} HistoryEntry;
+
+// Entries are a ring, newest at head. Everything is dropped when the
+// manifest changes, since the line indexes no longer line up.
+typedef struct {
+  uint32_t manifest_version;
+  uint8_t head;
+  uint8_t count;
+  HistoryEntry entries[HISTORY_ENTRIES];
+} StatusHistory;
+
+typedef char history_fits_in_store[sizeof(StatusHistory) <= STATUS_STORE_MAX_LENGTH ? 1 : -1];
+
+#define TUBE_STATUS(bit, severity, icon, label) typedef char history_keeps_status_bit_##bit[(bit) < HISTORY_STATUS_BITS ? 1 : -1];
+#include "tube-statuses.def"
+#undef TUBE_STATUS
+
+static uint16_t get_status(const HistoryEntry* entry, uint8_t line);
+static void set_status(HistoryEntry* entry, uint8_t line, uint16_t status);
+static void history_loaded(const uint8_t* data, uint16_t length);
+
+static StatusHistory history;
+static StatusHistoryLoadedHandler loaded_handler = NULL;
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+void status_history_init(StatusHistoryLoadedHandler handler) {
+  loaded_handler = handler;
+  status_store_load(STATUS_STORE_HISTORY, history_loaded);
+}
+
+// Only adds an entry when a status differs from the newest one, so the
+// ring covers as much time as it can.
+void status_history_record(uint32_t manifest_version, const uint32_t* statuses, uint8_t count) {
+  if (history.manifest_version != manifest_version) {
+    history.manifest_version = manifest_version;
+    history.count = 0;
+  }
+  if (history.count > 0) {
+    bool changed = false;
+    for (uint8_t l = 0; l < count && ! changed; l += 1) {
+      changed = get_status(&history.entries[history.head], l) != (statuses[l] & HISTORY_STATUS_MASK);
+    }
+    if (! changed) {
+      return;
+    }
+    history.head = (history.head + 1) % HISTORY_ENTRIES;
+  }
+  if (history.count < HISTORY_ENTRIES) {
+    history.count += 1;
+  }
+
+  HistoryEntry* entry = &history.entries[history.head];
+  entry->minute = status_history_now();
+  memset(entry->packed, 0, HISTORY_PACKED_SIZE);
+  for (uint8_t l = 0; l < count && l < MANIFEST_MAX_LINES; l += 1) {
+    set_status(entry, l, statuses[l]);
+  }
+  status_store_save(STATUS_STORE_HISTORY, (uint8_t*)&history, sizeof(history));
+}
+
+// Finds when the line took on its current status. seen_start is false if
+// the status goes back past the oldest entry, in which case the minute is
+// only an upper bound.
+bool status_history_since(uint32_t manifest_version, uint8_t line, uint32_t status, uint32_t* minute, bool* seen_start) {
+  if (history.manifest_version != manifest_version || history.count == 0) {
+    return false;
+  }
+  status &= HISTORY_STATUS_MASK;
+  bool found = false;
+  *seen_start = false;
+  for (uint8_t e = 0; e < history.count; e += 1) {
+    HistoryEntry* entry = &history.entries[(history.head + HISTORY_ENTRIES - e) % HISTORY_ENTRIES];
+    if (get_status(entry, line) != status) {
+      *seen_start = found;
+      break;
+    }
+    *minute = entry->minute;
+    found = true;
+  }
+  return found;
+}
+
+uint32_t status_history_now() {
+  PblTm now;
+  get_time(&now);
+  return (now.tm_yday * MINUTES_PER_DAY + now.tm_hour * 60 + now.tm_min) % MINUTES_PER_YEAR;
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+uint16_t get_status(const HistoryEntry* entry, uint8_t line) {
+  uint16_t bit = line * HISTORY_STATUS_BITS;
+  uint16_t status = 0;
+  for (uint8_t b = 0; b < HISTORY_STATUS_BITS; b += 1, bit += 1) {
+    if (entry->packed[bit / 8] & (1 << (bit % 8))) {
+      status |= 1 << b;
+    }
+  }
+  return status;
+}
+
+void set_status(HistoryEntry* entry, uint8_t line, uint16_t status) {
+  uint16_t bit = line * HISTORY_STATUS_BITS;
+  for (uint8_t b = 0; b < HISTORY_STATUS_BITS; b += 1, bit += 1) {
+    if (status & (1 << b)) {
+      entry->packed[bit / 8] |= 1 << (bit % 8);
+    }
+  }
+}
+
+// Anything recorded before the saved copy arrived is newer, so it wins.
+void history_loaded(const uint8_t* data, uint16_t length) {
+  if (length != sizeof(StatusHistory) || history.count > 0) {
+    return;
+  }
+  memcpy(&history, data, sizeof(history));
+  if (history.head >= HISTORY_ENTRIES || history.count > HISTORY_ENTRIES) {
+    memset(&history, 0, sizeof(history));
+    return;
+  }
+  if (loaded_handler) {
+    loaded_handler();
+  }
+}
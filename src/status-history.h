@@ -0,0 +1,38 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef STATUS_HISTORY_H
+#define STATUS_HISTORY_H
+
+// The last few distinct sets of line statuses, each with the time it was
+// first seen, bit packed and kept in the status store between runs. Used
+// to tell how long a line has had its current status without asking the
+// server. Times are in minutes since the start of the year.
+
+typedef void (*StatusHistoryLoadedHandler)(void);
+
+void status_history_init(StatusHistoryLoadedHandler handler);
+void status_history_record(uint32_t manifest_version, const uint32_t* statuses, uint8_t count);
+bool status_history_since(uint32_t manifest_version, uint8_t line, uint32_t status, uint32_t* minute, bool* seen_start);
+uint32_t status_history_now();
+
+#endif // STATUS_HISTORY_H
@@ -0,0 +1,190 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "status-parser.h"
+
+#define KEY_ORDER 0
+#define KEY_STATUSES 1
+#define KEY_SNAPSHOT 2
+#define KEY_UPDATE_TYPE 3
+#define KEY_MANIFEST 4
+
+#define V2_CODE_LENGTH 2
+#define V2_STATUS_LENGTH 3
+#define PACKED_STATUS_LENGTH 2
+
+static StatusParseResult parse_v2(Tuple* tuple_order, Tuple* tuple_statuses, StatusLineLookup find_line, StatusSnapshot* snapshot);
+static StatusParseResult parse_packed(Tuple* tuple_lines, Tuple* tuple_statuses, uint8_t line_count, StatusSnapshot* snapshot);
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+StatusParseResult status_parser_parse(DictionaryIterator* received, uint32_t manifest_version, uint8_t line_count, StatusLineLookup find_line, StatusSnapshot* snapshot) {
+  Tuple* tuple_order = dict_find(received, KEY_ORDER);
+  Tuple* tuple_statuses = dict_find(received, KEY_STATUSES);
+  Tuple* tuple_snapshot = dict_find(received, KEY_SNAPSHOT);
+  Tuple* tuple_update = dict_find(received, KEY_UPDATE_TYPE);
+  Tuple* tuple_manifest = dict_find(received, KEY_MANIFEST);
+  StatusParseResult result;
+  uint32_t value;
+
+  snapshot->update_type = STATUS_UPDATE_FULL;
+  snapshot->snapshot_id = 0;
+  snapshot->manifest_version = manifest_version;
+  snapshot->count = 0;
+
+  // Line indexes are only meaningful for the manifest the server used, so
+  // nothing else is read if it isn't ours.
+  if (tuple_manifest) {
+    if ((result = status_parser_read_uint(tuple_manifest, &snapshot->manifest_version)) != STATUS_PARSE_OK) {
+      return result;
+    }
+    if (snapshot->manifest_version != manifest_version) {
+      return STATUS_PARSE_MANIFEST_MISMATCH;
+    }
+  }
+  if (tuple_snapshot && (result = status_parser_read_uint(tuple_snapshot, &snapshot->snapshot_id)) != STATUS_PARSE_OK) {
+    return result;
+  }
+  if (tuple_update) {
+    if ((result = status_parser_read_uint(tuple_update, &value)) != STATUS_PARSE_OK) {
+      return result;
+    }
+    if (value > STATUS_UPDATE_DELTA) {
+      return STATUS_PARSE_BAD_VALUE;
+    }
+    snapshot->update_type = value;
+  }
+
+  if (snapshot->update_type == STATUS_UPDATE_UNCHANGED) {
+    return STATUS_PARSE_OK;
+  }
+  if (! tuple_order || ! tuple_statuses) {
+    return STATUS_PARSE_MISSING_KEY;
+  }
+  // Servers that understand format version 3 reply with byte arrays, older
+  // ones keep sending the v2 strings. Deltas are always byte arrays.
+  if (tuple_order->type == TUPLE_CSTRING && snapshot->update_type == STATUS_UPDATE_FULL) {
+    return parse_v2(tuple_order, tuple_statuses, find_line, snapshot);
+  }
+  return parse_packed(tuple_order, tuple_statuses, line_count, snapshot);
+}
+
+StatusParseResult status_parser_read_uint(Tuple* tuple, uint32_t* value) {
+  if (tuple->type != TUPLE_UINT && tuple->type != TUPLE_INT) {
+    return STATUS_PARSE_BAD_TYPE;
+  }
+  switch (tuple->length) {
+    case 1:
+      *value = tuple->value->uint8;
+    break;
+    case 2:
+      *value = tuple->value->uint16;
+    break;
+    case 4:
+      *value = tuple->value->uint32;
+    break;
+    default:
+      return STATUS_PARSE_BAD_LENGTH;
+  }
+  return STATUS_PARSE_OK;
+}
+
+// The phone is trusted to include the terminating NUL in the length, but
+// not to have put it at the end.
+uint16_t status_parser_cstring_length(Tuple* tuple) {
+  uint16_t length = 0;
+  while (length < tuple->length && tuple->value->cstring[length] != '\0') {
+    length += 1;
+  }
+  return length;
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+// Version 2: the order is a string of two letter line codes and the
+// statuses a string of three digit decimal numbers. Codes the manifest
+// doesn't know are skipped, since old servers may list lines it lacks.
+StatusParseResult parse_v2(Tuple* tuple_order, Tuple* tuple_statuses, StatusLineLookup find_line, StatusSnapshot* snapshot) {
+  if (tuple_statuses->type != TUPLE_CSTRING) {
+    return STATUS_PARSE_BAD_TYPE;
+  }
+  uint16_t order_length = status_parser_cstring_length(tuple_order);
+  uint16_t statuses_length = status_parser_cstring_length(tuple_statuses);
+  uint16_t count = order_length / V2_CODE_LENGTH;
+  if (order_length % V2_CODE_LENGTH != 0 || statuses_length != count * V2_STATUS_LENGTH) {
+    return STATUS_PARSE_BAD_LENGTH;
+  }
+
+  const char* order = tuple_order->value->cstring;
+  const char* statuses = tuple_statuses->value->cstring;
+  for (uint16_t p = 0; p < count; p += 1) {
+    uint32_t status = 0;
+    for (uint8_t d = 0; d < V2_STATUS_LENGTH; d += 1) {
+      char digit = statuses[p * V2_STATUS_LENGTH + d];
+      if (digit < '0' || digit > '9') {
+        return STATUS_PARSE_BAD_VALUE;
+      }
+      status = status * 10 + (digit - '0');
+    }
+    int line = find_line(order + p * V2_CODE_LENGTH);
+    if (line < 0) {
+      continue;
+    }
+    if (snapshot->count >= MANIFEST_MAX_LINES) {
+      return STATUS_PARSE_BAD_LENGTH;
+    }
+    snapshot->lines[snapshot->count] = line;
+    snapshot->statuses[snapshot->count] = status;
+    snapshot->count += 1;
+  }
+  return STATUS_PARSE_OK;
+}
+
+// Version 3 and later: one byte per entry holding an index into the line
+// manifest, and a little-endian uint16 status word per entry.
+StatusParseResult parse_packed(Tuple* tuple_lines, Tuple* tuple_statuses, uint8_t line_count, StatusSnapshot* snapshot) {
+  if (tuple_lines->type != TUPLE_BYTE_ARRAY || tuple_statuses->type != TUPLE_BYTE_ARRAY) {
+    return STATUS_PARSE_BAD_TYPE;
+  }
+  uint16_t count = tuple_lines->length;
+  if (count > line_count || tuple_statuses->length != count * PACKED_STATUS_LENGTH) {
+    return STATUS_PARSE_BAD_LENGTH;
+  }
+
+  const uint8_t* lines = tuple_lines->value->data;
+  const uint8_t* statuses = tuple_statuses->value->data;
+  for (uint16_t p = 0; p < count; p += 1) {
+    if (lines[p] >= line_count) {
+      return STATUS_PARSE_BAD_VALUE;
+    }
+    snapshot->lines[p] = lines[p];
+    snapshot->statuses[p] = statuses[p * 2] | (statuses[p * 2 + 1] << 8);
+  }
+  snapshot->count = count;
+  return STATUS_PARSE_OK;
+}
@@ -0,0 +1,61 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef STATUS_PARSER_H
+#define STATUS_PARSER_H
+
+// Reads a tube status response in place and checks every length before
+// using it. Nothing is applied unless the whole response is valid.
+
+#include "line-manifest.h"
+
+#define STATUS_UPDATE_FULL 0
+#define STATUS_UPDATE_UNCHANGED 1
+#define STATUS_UPDATE_DELTA 2
+
+typedef enum {
+  STATUS_PARSE_OK,
+  STATUS_PARSE_MISSING_KEY,
+  STATUS_PARSE_BAD_TYPE,
+  STATUS_PARSE_BAD_LENGTH,
+  STATUS_PARSE_BAD_VALUE,
+  STATUS_PARSE_MANIFEST_MISMATCH
+} StatusParseResult;
+
+typedef int (*StatusLineLookup)(const char* code);
+
+// For full updates position p of the list holds lines[p]. For deltas only
+// the lines listed have changed and the order is left alone.
+typedef struct {
+  uint8_t update_type;
+  uint32_t snapshot_id;
+  uint32_t manifest_version;
+  uint8_t count;
+  uint8_t lines[MANIFEST_MAX_LINES];
+  uint32_t statuses[MANIFEST_MAX_LINES];
+} StatusSnapshot;
+
+StatusParseResult status_parser_parse(DictionaryIterator* received, uint32_t manifest_version, uint8_t line_count, StatusLineLookup find_line, StatusSnapshot* snapshot);
+StatusParseResult status_parser_read_uint(Tuple* tuple, uint32_t* value);
+uint16_t status_parser_cstring_length(Tuple* tuple);
+
+#endif // STATUS_PARSER_H
@@ -0,0 +1,215 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "status-store.h"
+#include "diagnostics.h"
+
+#define MAX_PENDING 10
+#define MAX_SAVE_BUFFERS 2
+#define NO_SAVE -1
+
+typedef struct {
+  uint32_t key;
+  StatusStoreLoadedHandler handler;
+  int8_t save;
+} PendingMessage;
+
+typedef struct {
+  bool used;
+  uint16_t length;
+  uint8_t data[STATUS_STORE_MAX_LENGTH];
+} SaveBuffer;
+
+static PendingMessage* queue_message(uint32_t key);
+static void send_next();
+static HTTPResult send_message(PendingMessage* message);
+static void pop_message();
+static PendingMessage* find_queued_save(uint32_t key);
+static int8_t get_save_buffer();
+
+// httpebble takes one outbound message at a time and refuses another
+// until the phone has answered it, so loads and saves share one queue and
+// go out one after another. The front of the queue is the message waiting
+// for its answer. A queued save keeps a copy of its data, since callers
+// often save from the stack.
+static PendingMessage pending[MAX_PENDING];
+static uint8_t pending_count = 0;
+static bool message_in_flight = false;
+static SaveBuffer save_buffers[MAX_SAVE_BUFFERS];
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+void status_store_load(uint32_t key, StatusStoreLoadedHandler handler) {
+  PendingMessage* message = queue_message(key);
+  if (! message) {
+    return;
+  }
+  message->handler = handler;
+  send_next();
+}
+
+// A save replaces one for the same key that hasn't gone out yet.
+void status_store_save(uint32_t key, const uint8_t* data, uint16_t length) {
+  if (length > STATUS_STORE_MAX_LENGTH) {
+    diagnostics_count(DIAG_STORE_DROPPED);
+    return;
+  }
+  PendingMessage* message = find_queued_save(key);
+  if (! message) {
+    int8_t save = get_save_buffer();
+    if (save == NO_SAVE) {
+      diagnostics_count(DIAG_STORE_DROPPED);
+      return;
+    }
+    message = queue_message(key);
+    if (! message) {
+      save_buffers[save].used = false;
+      return;
+    }
+    message->save = save;
+  }
+  memcpy(save_buffers[message->save].data, data, length);
+  save_buffers[message->save].length = length;
+  send_next();
+}
+
+// A load or save is waiting for the phone to answer. Anything else sent
+// meanwhile would be refused.
+bool status_store_busy() {
+  return message_in_flight;
+}
+
+// Sends whatever httpebble refused earlier. Called when a response shows
+// the outbound message is free again.
+void status_store_flush() {
+  send_next();
+}
+
+// A missing cookie comes back as a NULL result, so the handler is taken
+// from the front of the queue rather than from the result's key.
+void status_store_cookie_get(int32_t request_id, Tuple* result, void* context) {
+  if (! message_in_flight || pending[0].save != NO_SAVE) {
+    return;
+  }
+  StatusStoreLoadedHandler handler = pending[0].handler;
+  pop_message();
+
+  if (handler && result && result->type == TUPLE_BYTE_ARRAY) {
+    handler(result->value->data, result->length);
+  }
+  send_next();
+}
+
+// A save the phone couldn't store is dropped; the next save of the same
+// key has the newer data anyway.
+void status_store_cookie_set(int32_t request_id, bool successful, void* context) {
+  if (! message_in_flight || pending[0].save == NO_SAVE) {
+    return;
+  }
+  pop_message();
+  send_next();
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+// A full queue is counted where the diagnostics screen shows it; raise
+// MAX_PENDING if it is ever non-zero.
+PendingMessage* queue_message(uint32_t key) {
+  if (pending_count >= MAX_PENDING) {
+    diagnostics_count(DIAG_STORE_DROPPED);
+    return NULL;
+  }
+  PendingMessage* message = &pending[pending_count];
+  message->key = key;
+  message->handler = NULL;
+  message->save = NO_SAVE;
+  pending_count += 1;
+  return message;
+}
+
+// A message httpebble is too busy for stays at the front of the queue
+// until status_store_flush. Any other error drops it, the same as a
+// missing cookie.
+void send_next() {
+  while (pending_count > 0 && ! message_in_flight) {
+    HTTPResult result = send_message(&pending[0]);
+    if (pending[0].save != NO_SAVE && result != HTTP_BUSY) {
+      save_buffers[pending[0].save].used = false;
+    }
+    if (result == HTTP_OK) {
+      message_in_flight = true;
+    }
+    else if (result == HTTP_BUSY) {
+      return;
+    }
+    else {
+      pop_message();
+    }
+  }
+}
+
+HTTPResult send_message(PendingMessage* message) {
+  if (message->save == NO_SAVE) {
+    return http_cookie_get(STATUS_STORE_REQUEST, message->key);
+  }
+  DictionaryIterator* iter;
+  HTTPResult result = http_cookie_set_start(STATUS_STORE_REQUEST, &iter);
+  if (result != HTTP_OK) {
+    return result;
+  }
+  SaveBuffer* buffer = &save_buffers[message->save];
+  dict_write_data(iter, message->key, buffer->data, buffer->length);
+  return http_cookie_set_end();
+}
+
+void pop_message() {
+  message_in_flight = false;
+  pending_count -= 1;
+  memmove(&pending[0], &pending[1], pending_count * sizeof(PendingMessage));
+}
+
+// The message at the front has already gone out, so it isn't replaced.
+PendingMessage* find_queued_save(uint32_t key) {
+  for (int m = message_in_flight ? 1 : 0; m < pending_count; m += 1) {
+    if (pending[m].save != NO_SAVE && pending[m].key == key) {
+      return &pending[m];
+    }
+  }
+  return NULL;
+}
+
+int8_t get_save_buffer() {
+  for (int b = 0; b < MAX_SAVE_BUFFERS; b += 1) {
+    if (! save_buffers[b].used) {
+      save_buffers[b].used = true;
+      return b;
+    }
+  }
+  return NO_SAVE;
+}
@@ -0,0 +1,55 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef STATUS_STORE_H
+#define STATUS_STORE_H
+
+// Persists a few opaque blobs (the last status snapshot, the line manifest)
+// between runs of the app. This implementation keeps them in the httpebble
+// cookie store on the phone; anything providing these functions can stand
+// in for it. Loads and saves go out in the order they were made, one at a
+// time, and loads are answered in that order.
+
+#define STATUS_STORE_REQUEST 8826
+
+#define STATUS_STORE_SNAPSHOT 1
+#define STATUS_STORE_MANIFEST 2
+#define STATUS_STORE_WATCHED 3
+#define STATUS_STORE_HISTORY 4
+#define STATUS_STORE_OUTBOX 5
+#define STATUS_STORE_STOPS 6
+#define STATUS_STORE_MANIFEST_REST 7
+
+// httpebble's outbound message buffer is 256 bytes, and a save spends
+// about 30 of them on the dictionary and the cookie's own tuples.
+#define STATUS_STORE_MAX_LENGTH 226
+
+typedef void (*StatusStoreLoadedHandler)(const uint8_t* data, uint16_t length);
+
+void status_store_load(uint32_t key, StatusStoreLoadedHandler handler);
+void status_store_save(uint32_t key, const uint8_t* data, uint16_t length);
+bool status_store_busy();
+void status_store_flush();
+void status_store_cookie_get(int32_t request_id, Tuple* result, void* context);
+void status_store_cookie_set(int32_t request_id, bool successful, void* context);
+
+#endif // STATUS_STORE_H
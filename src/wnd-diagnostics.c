@@ -0,0 +1,81 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "pebble_fonts.h"
+#include "diagnostics.h"
+#include "wnd-diagnostics.h"
+
+#define DIAGNOSTICS_TEXT_LENGTH 512
+
+static void build_window();
+
+static Window window;
+static ScrollLayer layer_scroll;
+static TextLayer layer_text;
+static char diagnostics_text[DIAGNOSTICS_TEXT_LENGTH];
+static bool window_built = false;
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+// The numbers are read when the window is shown and not updated while it
+// is open.
+void wnd_diagnostics_show() {
+  const int vert_scroll_text_padding = 4;
+
+  if (! window_built) {
+    build_window();
+  }
+  diagnostics_format(diagnostics_text, sizeof(diagnostics_text));
+  text_layer_set_size(&layer_text, GSize(136, 2000));
+  text_layer_set_text(&layer_text, diagnostics_text);
+  GSize max_size = text_layer_get_max_used_size(app_get_current_graphics_context(), &layer_text);
+  text_layer_set_size(&layer_text, max_size);
+  scroll_layer_set_content_size(&layer_scroll, GSize(144, max_size.h + vert_scroll_text_padding));
+  scroll_layer_set_content_offset(&layer_scroll, GPointZero, false);
+  window_stack_push(&window, true);
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+void build_window() {
+  window_init(&window, "Diagnostics Window");
+
+  scroll_layer_init(&layer_scroll, window.layer.frame);
+  scroll_layer_set_click_config_onto_window(&layer_scroll, &window);
+  layer_add_child(&window.layer, &layer_scroll.layer);
+
+  text_layer_init(&layer_text, GRect(4, 0, 136, 2000));
+  text_layer_set_text_color(&layer_text, GColorBlack);
+  text_layer_set_background_color(&layer_text, GColorClear);
+  text_layer_set_font(&layer_text, fonts_get_system_font(FONT_KEY_GOTHIC_18));
+  text_layer_set_text_alignment(&layer_text, GTextAlignmentLeft);
+  text_layer_set_overflow_mode(&layer_text, GTextOverflowModeWordWrap);
+  scroll_layer_add_child(&layer_scroll, &layer_text.layer);
+
+  window_built = true;
+}
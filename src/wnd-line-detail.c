@@ -0,0 +1,177 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "pebble_fonts.h"
+#include "config.h"
+#include "http.h"
+#include "request-scheduler.h"
+#include "chunk-assembly.h"
+#include "disruption-cache.h"
+#include "wnd-line-detail.h"
+
+#define KEY_CODE 0
+#define KEY_STATUS 1
+
+static void build_window();
+static void write_detail_request(DictionaryIterator* body);
+static bool is_current_line(Tuple* tuple_code);
+static void set_detail_text(const char* text);
+
+static Window window;
+static ScrollLayer layer_scroll;
+static TextLayer layer_text_name;
+static TextLayer layer_text_detail;
+
+static char line_code[3];
+static char line_name[20];
+static uint32_t line_status;
+static bool window_built = false;
+
+static uint8_t detail_arena[DISRUPTION_TEXT_LENGTH];
+static ChunkAssembly detail_assembly;
+
+static const ScheduledRequest detail_request = {
+  .cookie = HTTP_LINE_DETAIL,
+  .url = API_BASE_URL "/london-tube/v2/detail.php",
+  .write_body = write_detail_request,
+  .success = wnd_line_detail_http_success,
+  .failure = wnd_line_detail_http_failure
+};
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+void wnd_line_detail_init() {
+  chunk_assembly_init(&detail_assembly, detail_arena, sizeof(detail_arena), NULL, NULL);
+  request_scheduler_register(&detail_request);
+}
+
+// Shows a cached description straight away, otherwise fetches it for
+// this one line.
+void wnd_line_detail_show(const char* code, const char* name, uint32_t status) {
+  strncpy(line_code, code, 2);
+  line_code[2] = '\0';
+  strncpy(line_name, name, sizeof(line_name) - 1);
+  line_status = status;
+
+  if (! window_built) {
+    build_window();
+  }
+
+  const char* cached = disruption_cache_get(line_code, line_status);
+  if (cached) {
+    set_detail_text(cached);
+  }
+  else {
+    set_detail_text("Loading...");
+    chunk_assembly_reset(&detail_assembly);
+    request_scheduler_send(HTTP_LINE_DETAIL);
+  }
+  window_stack_push(&window, true);
+}
+
+void wnd_line_detail_http_failure(int32_t cookie, int http_status, void* context) {
+  set_detail_text("Could not load the details.");
+}
+
+void wnd_line_detail_http_success(int32_t cookie, int http_status, DictionaryIterator* received, void* context) {
+  Tuple* tuple_code = dict_find(received, KEY_CODE);
+  if (! tuple_code || tuple_code->type != TUPLE_CSTRING) {
+    set_detail_text("Could not load the details.");
+    return;
+  }
+  // A late response for a line that is no longer shown is dropped. The
+  // request for the line now shown could not go out while that one was in
+  // flight, so it is sent now.
+  if (! is_current_line(tuple_code)) {
+    if (! disruption_cache_get(line_code, line_status)) {
+      request_scheduler_send(HTTP_LINE_DETAIL);
+    }
+    return;
+  }
+  switch (chunk_assembly_add(&detail_assembly, received)) {
+    case CHUNK_INCOMPLETE:
+      request_scheduler_send(HTTP_LINE_DETAIL);
+    break;
+    case CHUNK_COMPLETE:
+      disruption_cache_put(line_code, line_status, detail_arena, detail_assembly.total);
+      set_detail_text(disruption_cache_get(line_code, line_status));
+    break;
+    case CHUNK_ERROR:
+      set_detail_text("Could not load the details.");
+    break;
+  }
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+void build_window() {
+  window_init(&window, "Line Detail Window");
+
+  scroll_layer_init(&layer_scroll, window.layer.frame);
+  scroll_layer_set_click_config_onto_window(&layer_scroll, &window);
+  layer_add_child(&window.layer, &layer_scroll.layer);
+
+  text_layer_init(&layer_text_name, GRect(4, 0, 136, 28));
+  text_layer_set_text_color(&layer_text_name, GColorBlack);
+  text_layer_set_background_color(&layer_text_name, GColorClear);
+  text_layer_set_font(&layer_text_name, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD));
+  text_layer_set_text(&layer_text_name, line_name);
+  scroll_layer_add_child(&layer_scroll, &layer_text_name.layer);
+
+  text_layer_init(&layer_text_detail, GRect(4, 28, 136, 2000));
+  text_layer_set_text_color(&layer_text_detail, GColorBlack);
+  text_layer_set_background_color(&layer_text_detail, GColorClear);
+  text_layer_set_font(&layer_text_detail, fonts_get_system_font(FONT_KEY_GOTHIC_18));
+  text_layer_set_text_alignment(&layer_text_detail, GTextAlignmentLeft);
+  text_layer_set_overflow_mode(&layer_text_detail, GTextOverflowModeWordWrap);
+  scroll_layer_add_child(&layer_scroll, &layer_text_detail.layer);
+
+  window_built = true;
+}
+
+void write_detail_request(DictionaryIterator* body) {
+  dict_write_cstring(body, KEY_CODE, line_code);
+  dict_write_uint32(body, KEY_STATUS, line_status);
+  chunk_assembly_write_request(&detail_assembly, body);
+}
+
+// Compares the terminating null too, without reading past the tuple.
+bool is_current_line(Tuple* tuple_code) {
+  size_t length = strlen(line_code);
+  return tuple_code->length > length && strncmp(tuple_code->value->cstring, line_code, length + 1) == 0;
+}
+
+void set_detail_text(const char* text) {
+  const int vert_scroll_text_padding = 4;
+  text_layer_set_size(&layer_text_detail, GSize(136, 2000));
+  text_layer_set_text(&layer_text_detail, text);
+  GSize max_size = text_layer_get_max_used_size(app_get_current_graphics_context(), &layer_text_detail);
+  text_layer_set_size(&layer_text_detail, max_size);
+  scroll_layer_set_content_size(&layer_scroll, GSize(144, 28 + max_size.h + vert_scroll_text_padding));
+}
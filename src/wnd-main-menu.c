@@ -27,6 +27,9 @@
 #include "smallstone.h"
 #include "wnd-tube-status.h"
 #include "wnd-main-menu.h"
+#include "wnd-next-bus.h"
+#include "font-manager.h"
+#include "icon-atlas.h"
 
 #define NUM_ICONS 3
 #define ICON_THANKS 0
@@ -45,7 +48,9 @@ static void menu_select_click_callback(MenuLayer *menu_layer, MenuIndex *cell_in
 
 static Window window;
 static MenuLayer layer_menu;
-static HeapBitmap icons[NUM_ICONS];
+static GBitmap* icon_atlas = NULL;
+static GBitmap icons[NUM_ICONS];
+static bool window_loaded = false;
 
 /**
  PUBLIC FUNCTIONS
@@ -63,6 +68,13 @@ void wnd_main_menu_show() {
   window_stack_push(&window, true);
 }
 
+// Called when the tube status digest changes.
+void wnd_main_menu_refresh() {
+  if (window_loaded) {
+    menu_layer_reload_data(&layer_menu);
+  }
+}
+
 /**
  PRIVATE FUNCTIONS
  **/
@@ -81,15 +93,20 @@ void window_load(Window *me) {
   menu_layer_set_click_config_onto_window(&layer_menu, me);
   layer_add_child(&me->layer, menu_layer_get_layer(&layer_menu));
 
-  heap_bitmap_init(&icons[ICON_THANKS], RESOURCE_ID_MENU_ICON_THANKS);
-  heap_bitmap_init(&icons[ICON_TUBE], RESOURCE_ID_MENU_ICON_TUBE);
-  heap_bitmap_init(&icons[ICON_BUS], RESOURCE_ID_MENU_ICON_BUS);
+  // The icons are views into one shared bitmap, see tools/pack-icons.py.
+  icon_atlas = font_manager_get_bitmap(RESOURCE_ID_ICON_ATLAS);
+  if (icon_atlas) {
+    gbitmap_init_as_sub_bitmap(&icons[ICON_THANKS], icon_atlas, ICON_ATLAS_MENU_THANKS);
+    gbitmap_init_as_sub_bitmap(&icons[ICON_TUBE], icon_atlas, ICON_ATLAS_MENU_TUBE);
+    gbitmap_init_as_sub_bitmap(&icons[ICON_BUS], icon_atlas, ICON_ATLAS_MENU_BUS);
+  }
+  window_loaded = true;
 }
 
 void window_unload(Window *me) {
-  heap_bitmap_deinit(&icons[ICON_THANKS]);
-  heap_bitmap_deinit(&icons[ICON_TUBE]);
-  heap_bitmap_deinit(&icons[ICON_BUS]);
+  window_loaded = false;
+  font_manager_release(RESOURCE_ID_ICON_ATLAS);
+  icon_atlas = NULL;
 }
 
 uint16_t menu_get_num_sections_callback(MenuLayer *me, void *data) {
@@ -105,6 +122,9 @@ int16_t menu_get_header_height_callback(MenuLayer *me, uint16_t section_index, v
 }
 
 int16_t menu_get_cell_height_callback(MenuLayer *me, MenuIndex* cell_index, void *data) {
+  if (cell_index->row == 0 && wnd_tube_status_digest()[0]) {
+    return 48;
+  }
   return 40;
 }
 
@@ -114,7 +134,7 @@ void menu_draw_header_callback(GContext* ctx, const Layer *cell_layer, uint16_t
 
 void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
   char row_text[20];
-  HeapBitmap* icon = NULL;
+  GBitmap* icon = NULL;
   switch (cell_index->row) {
     case 0:
       strcpy(row_text, "Tube Status");
@@ -130,10 +150,13 @@ void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *c
     break;
   }
   graphics_context_set_text_color(ctx, GColorBlack);
-  if (icon) {
-    graphics_draw_bitmap_in_rect(ctx, &icon->bmp, GRect(4, 4, 24, 28));
+  if (icon && icon_atlas) {
+    graphics_draw_bitmap_in_rect(ctx, icon, GRect(4, 4, 24, 28));
   }
   graphics_text_draw(ctx, row_text, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), GRect(32, 2, 108, 26), 0, GTextAlignmentLeft, NULL);
+  if (cell_index->row == 0) {
+    graphics_text_draw(ctx, wnd_tube_status_digest(), fonts_get_system_font(FONT_KEY_GOTHIC_14), GRect(32, 28, 108, 16), 0, GTextAlignmentLeft, NULL);
+  }
 }
 
 void menu_select_click_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
@@ -141,6 +164,9 @@ void menu_select_click_callback(MenuLayer *menu_layer, MenuIndex *cell_index, vo
     case 0:
       wnd_tube_status_show();
     break;
+    case 1:
+      wnd_next_bus_show();
+    break;
     case 2:
       send_thanks("london-transport", VERSION_MAJOR, VERSION_MINOR);
       show_thanks_window();
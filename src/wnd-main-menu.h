@@ -25,5 +25,6 @@
 
 void wnd_main_menu_init();
 void wnd_main_menu_show();
+void wnd_main_menu_refresh();
 
 #endif // WND_MAIN_MENU_H
\ No newline at end of file
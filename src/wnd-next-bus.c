@@ -0,0 +1,348 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "pebble_fonts.h"
+#include "config.h"
+#include "http.h"
+#include "request-scheduler.h"
+#include "status-store.h"
+#include "wnd-next-bus.h"
+
+// Arrivals are sent as packed 8 byte records: vehicle id (uint16, little
+// endian), route (4 chars, not terminated), destination index, minutes due.
+typedef struct {
+  uint16_t vehicle;
+  char route[4];
+  uint8_t destination;
+  uint8_t due;
+} BusArrival;
+
+#define ARRIVAL_RECORD_SIZE 8
+#define MAX_ARRIVALS 16
+#define MAX_DESTINATIONS 8
+#define DESTINATION_LENGTH 20
+#define STOP_CODES_LENGTH 48
+
+#define STATE_UPDATING 0
+#define STATE_OK 1
+#define STATE_ERROR 2
+
+#define KEY_STOPS 0
+#define KEY_ARRIVALS 0
+#define KEY_DESTINATIONS 1
+#define KEY_SAVED_STOPS 2
+
+static void build_window();
+static void window_load(Window *me);
+static uint16_t menu_get_num_sections_callback(MenuLayer *me, void *data);
+static uint16_t menu_get_num_rows_callback(MenuLayer *me, uint16_t section_index, void *data);
+static int16_t menu_get_header_height_callback(MenuLayer *me, uint16_t section_index, void *data);
+static int16_t menu_get_cell_height_callback(MenuLayer *me, MenuIndex* cell_index, void *data);
+static void menu_draw_header_callback(GContext* ctx, const Layer *cell_layer, uint16_t section_index, void *data);
+static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data);
+static void menu_select_click_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+static void write_arrivals_request(DictionaryIterator* body);
+static void parse_destinations(const char* names);
+static void apply_arrival(const uint8_t* record, uint32_t* seen);
+static int find_arrival(uint16_t vehicle);
+static void update_arrival_order();
+static void stops_loaded(const uint8_t* data, uint16_t length);
+static bool set_stop_codes(const char* codes, uint16_t length);
+
+static Window window;
+static MenuLayer layer_menu;
+static int state = STATE_UPDATING;
+static bool window_built = false;
+
+// The saved stops, sent to the server as a comma separated list. Stops
+// are chosen on the server, which sends the list back whenever it differs
+// from the one the watch sent; the watch keeps it in the status store.
+// The default is only used until a list has been saved.
+static char stop_codes[STOP_CODES_LENGTH] = "53272,47920";
+
+// Fixed ring of arrivals. A response only rewrites the slots whose record
+// changed. New vehicles take a free slot, or else the next slot in the
+// ring, overwriting the oldest.
+static BusArrival arrivals[MAX_ARRIVALS];
+static uint8_t arrival_head = 0;
+static uint8_t arrival_order[MAX_ARRIVALS];
+static uint8_t num_arrivals = 0;
+static char destinations[MAX_DESTINATIONS][DESTINATION_LENGTH];
+
+static const ScheduledRequest arrivals_request = {
+  .cookie = HTTP_NEXT_BUS,
+  .url = API_BASE_URL "/london-bus/v1/arrivals.php",
+  .write_body = write_arrivals_request,
+  .success = wnd_next_bus_http_success,
+  .failure = wnd_next_bus_http_failure
+};
+
+/**
+ PUBLIC FUNCTIONS
+ **/
+
+void wnd_next_bus_init() {
+  request_scheduler_register(&arrivals_request);
+  status_store_load(STATUS_STORE_STOPS, stops_loaded);
+}
+
+void wnd_next_bus_show() {
+  if (! window_built) {
+    build_window();
+  }
+  window_stack_push(&window, true);
+}
+
+void wnd_next_bus_http_failure(int32_t cookie, int http_status, void* context) {
+  state = STATE_ERROR;
+  menu_layer_reload_data(&layer_menu);
+}
+
+void wnd_next_bus_http_success(int32_t cookie, int http_status, DictionaryIterator* received, void* context) {
+  Tuple* tuple_arrivals = dict_find(received, KEY_ARRIVALS);
+  Tuple* tuple_destinations = dict_find(received, KEY_DESTINATIONS);
+  Tuple* tuple_stops = dict_find(received, KEY_SAVED_STOPS);
+
+  if (tuple_stops && tuple_stops->type == TUPLE_CSTRING && set_stop_codes(tuple_stops->value->cstring, tuple_stops->length)) {
+    status_store_save(STATUS_STORE_STOPS, (const uint8_t*)stop_codes, strlen(stop_codes));
+  }
+
+  if (tuple_destinations && tuple_destinations->type == TUPLE_CSTRING) {
+    parse_destinations(tuple_destinations->value->cstring);
+  }
+
+  uint32_t seen = 0;
+  if (tuple_arrivals && tuple_arrivals->type == TUPLE_BYTE_ARRAY) {
+    int count = tuple_arrivals->length / ARRIVAL_RECORD_SIZE;
+    for (int r = 0; r < count; r += 1) {
+      apply_arrival(tuple_arrivals->value->data + (r * ARRIVAL_RECORD_SIZE), &seen);
+    }
+  }
+
+  // Vehicles missing from the response have gone, so their slots are freed.
+  for (int a = 0; a < MAX_ARRIVALS; a += 1) {
+    if (! (seen & (1 << a))) {
+      arrivals[a].vehicle = 0;
+    }
+  }
+
+  update_arrival_order();
+  state = STATE_OK;
+  menu_layer_reload_data(&layer_menu);
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+void build_window() {
+  window_init(&window, "Next Bus Window");
+  window_set_window_handlers(&window, (WindowHandlers){
+    .load = window_load
+  });
+
+  menu_layer_init(&layer_menu, window.layer.bounds);
+  menu_layer_set_callbacks(&layer_menu, NULL, (MenuLayerCallbacks){
+    .get_num_sections = menu_get_num_sections_callback,
+    .get_num_rows = menu_get_num_rows_callback,
+    .get_header_height = menu_get_header_height_callback,
+    .get_cell_height = menu_get_cell_height_callback,
+    .draw_header = menu_draw_header_callback,
+    .draw_row = menu_draw_row_callback,
+    .select_click = menu_select_click_callback
+  });
+  menu_layer_set_click_config_onto_window(&layer_menu, &window);
+  layer_add_child(&window.layer, menu_layer_get_layer(&layer_menu));
+  window_built = true;
+}
+
+void window_load(Window* me) {
+  state = STATE_UPDATING;
+  menu_layer_reload_data(&layer_menu);
+  request_scheduler_send(HTTP_NEXT_BUS);
+}
+
+void write_arrivals_request(DictionaryIterator* body) {
+  dict_write_cstring(body, KEY_STOPS, stop_codes);
+}
+
+// Destination names come as a single '|' separated string.
+void parse_destinations(const char* names) {
+  int d = 0;
+  int c = 0;
+  for (const char* p = names; *p && d < MAX_DESTINATIONS; p += 1) {
+    if (*p == '|') {
+      destinations[d][c] = '\0';
+      d += 1;
+      c = 0;
+    }
+    else if (c < DESTINATION_LENGTH - 1) {
+      destinations[d][c] = *p;
+      c += 1;
+    }
+  }
+  if (d < MAX_DESTINATIONS) {
+    destinations[d][c] = '\0';
+  }
+}
+
+void apply_arrival(const uint8_t* record, uint32_t* seen) {
+  BusArrival arrival;
+  arrival.vehicle = record[0] | (record[1] << 8);
+  memcpy(arrival.route, record + 2, sizeof(arrival.route));
+  arrival.destination = record[6];
+  arrival.due = record[7];
+  if (arrival.vehicle == 0) {
+    return;
+  }
+
+  int slot = find_arrival(arrival.vehicle);
+  if (slot < 0) {
+    slot = find_arrival(0);
+  }
+  if (slot < 0) {
+    slot = arrival_head;
+    arrival_head = (arrival_head + 1) % MAX_ARRIVALS;
+  }
+  // Two records for the same vehicle in one response: keep the first.
+  if (*seen & (1 << slot)) {
+    return;
+  }
+  *seen |= (1 << slot);
+  if (memcmp(&arrivals[slot], &arrival, sizeof(arrival)) != 0) {
+    arrivals[slot] = arrival;
+  }
+}
+
+int find_arrival(uint16_t vehicle) {
+  for (int a = 0; a < MAX_ARRIVALS; a += 1) {
+    if (arrivals[a].vehicle == vehicle) {
+      return a;
+    }
+  }
+  return -1;
+}
+
+// Insertion sort of the occupied slots by minutes due. Done once per
+// response so the draw callbacks can index straight into it.
+void update_arrival_order() {
+  num_arrivals = 0;
+  for (int a = 0; a < MAX_ARRIVALS; a += 1) {
+    if (arrivals[a].vehicle == 0) {
+      continue;
+    }
+    int pos = num_arrivals;
+    while (pos > 0 && arrivals[arrival_order[pos - 1]].due > arrivals[a].due) {
+      arrival_order[pos] = arrival_order[pos - 1];
+      pos -= 1;
+    }
+    arrival_order[pos] = a;
+    num_arrivals += 1;
+  }
+}
+
+void stops_loaded(const uint8_t* data, uint16_t length) {
+  set_stop_codes((const char*)data, length);
+}
+
+// Only digits and commas are accepted, so a bad list can't end up in the
+// request. Returns whether the list changed.
+bool set_stop_codes(const char* codes, uint16_t length) {
+  uint16_t c = 0;
+  while (c < length && codes[c] != '\0') {
+    if ((codes[c] < '0' || codes[c] > '9') && codes[c] != ',') {
+      return false;
+    }
+    c += 1;
+  }
+  if (c == 0 || c >= STOP_CODES_LENGTH) {
+    return false;
+  }
+  if (strncmp(stop_codes, codes, c) == 0 && stop_codes[c] == '\0') {
+    return false;
+  }
+  memcpy(stop_codes, codes, c);
+  stop_codes[c] = '\0';
+  return true;
+}
+
+uint16_t menu_get_num_sections_callback(MenuLayer *me, void *data) {
+  return 1;
+}
+
+uint16_t menu_get_num_rows_callback(MenuLayer *me, uint16_t section_index, void *data) {
+  return num_arrivals > 0 ? num_arrivals : 1;
+}
+
+int16_t menu_get_header_height_callback(MenuLayer *me, uint16_t section_index, void *data) {
+  return MENU_CELL_BASIC_HEADER_HEIGHT;
+}
+
+int16_t menu_get_cell_height_callback(MenuLayer *me, MenuIndex* cell_index, void *data) {
+  return 40;
+}
+
+void menu_draw_header_callback(GContext* ctx, const Layer *cell_layer, uint16_t section_index, void *data) {
+  switch (state) {
+    case STATE_UPDATING:
+      menu_cell_basic_header_draw(ctx, cell_layer, "Updating...");
+    break;
+    case STATE_OK:
+      menu_cell_basic_header_draw(ctx, cell_layer, "Next Buses");
+    break;
+    case STATE_ERROR:
+      menu_cell_basic_header_draw(ctx, cell_layer, "Updating Failed");
+    break;
+  }
+}
+
+void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
+  graphics_context_set_text_color(ctx, GColorBlack);
+  if (num_arrivals == 0) {
+    graphics_text_draw(ctx, state == STATE_UPDATING ? "Getting Arrivals" : "No Arrivals", fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), GRect(4, 4, 136, 28), 0, GTextAlignmentLeft, NULL);
+    return;
+  }
+
+  BusArrival* arrival = &arrivals[arrival_order[cell_index->row]];
+  char route[5];
+  char due[8];
+  memcpy(route, arrival->route, sizeof(arrival->route));
+  route[4] = '\0';
+  if (arrival->due == 0) {
+    strcpy(due, "Due");
+  }
+  else {
+    snprintf(due, sizeof(due), "%d min", arrival->due);
+  }
+  const char* destination = arrival->destination < MAX_DESTINATIONS ? destinations[arrival->destination] : "";
+
+  graphics_text_draw(ctx, route, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), GRect(4, 0, 60, 26), 0, GTextAlignmentLeft, NULL);
+  graphics_text_draw(ctx, due, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), GRect(64, 0, 76, 26), 0, GTextAlignmentRight, NULL);
+  graphics_text_draw(ctx, destination, fonts_get_system_font(FONT_KEY_GOTHIC_14), GRect(4, 22, 136, 16), GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+}
+
+void menu_select_click_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
+  request_scheduler_send(HTTP_NEXT_BUS);
+}
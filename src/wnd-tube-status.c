@@ -26,130 +26,304 @@
 #include "config.h"
 #include "http.h"
 #include "wnd-tube-status.h"
+#include "status-store.h"
+#include "request-scheduler.h"
+#include "wnd-line-detail.h"
+#include "font-manager.h"
+#include "icon-atlas.h"
+#include "line-manifest.h"
+#include "status-parser.h"
+#include "diagnostics.h"
+#include "wnd-diagnostics.h"
+#include "status-history.h"
+#include "wnd-main-menu.h"
+
+#define STATUS_LABEL_LENGTH 112
 
 typedef struct {
-  char code[3];
-  int status;
-  char name[20];
-  int ordering;
-} TubeLine;
+  char label[STATUS_LABEL_LENGTH];
+  uint8_t label_length;
+  uint8_t label_height;
+  uint8_t row_height;
+  uint8_t icon;
+  char since[24];
+} TubeLineRender;
 
 #define max(a,b) ({ __typeof__ (a) _a = (a); __typeof__ (b) _b = (b); _a > _b ? _a : _b; })
 
-#define NUM_LINES 13
+#define MAX_LINES MANIFEST_MAX_LINES
 #define NUM_ICONS 3
 
 #define MENU_ICON_OK 0
 #define MENU_ICON_PROBLEM 1
 #define MENU_ICON_UNKNOWN 2
 
+#define SEVERITY_NONE 0
+#define SEVERITY_MINOR 1
+#define SEVERITY_SEVERE 2
+
+#define STATUS_GOOD_SERVICE 1
+
+#define LABEL_TOP 19
+#define LABEL_LINE_HEIGHT 18
+#define SINCE_HEIGHT 16
+#define ROW_MIN_HEIGHT 40
+
 #define STATE_UPDATING 0
 #define STATE_OK 1
 #define STATE_ERROR 2
 
+#define REFRESH_DISRUPTED_MS (2 * 60 * 1000)
+#define REFRESH_GOOD_MS (5 * 60 * 1000)
+#define REFRESH_CLOSED_MS (15 * 60 * 1000)
+
 #define SECTION_LINES 0
 #define SECTION_OPTIONS 1
 
+#define OPTION_REFRESH 0
+#define OPTION_SHOW_ALL 1
+#define OPTION_DIAGNOSTICS 2
+#define NUM_OPTIONS 2
+
 #define FONT_ROW_HEADER 0
 #define FONT_ROW_BODY 1
 
+#define STATUS_FORMAT_VERSION 4
+
+// Request keys. The response keys are read by status-parser.c.
+#define KEY_VERSION 1
+#define KEY_SNAPSHOT 2
+#define KEY_MANIFEST 4
+#define KEY_WATCHED 5
+
+#define SAVED_STATUS_VERSION 2
+
+typedef struct {
+  uint8_t bit;
+  uint8_t severity;
+  uint8_t icon;
+  uint8_t label_length;
+  const char* label;
+} StatusFlag;
+
+// Built from tube-statuses.def, so adding a status only means adding a
+// line there.
+static const StatusFlag status_flags[] = {
+#define TUBE_STATUS(bit, severity, icon, label) { bit, severity, icon, sizeof(label) - 1, label },
+#include "tube-statuses.def"
+#undef TUBE_STATUS
+};
+
+#define NUM_STATUS_FLAGS (sizeof(status_flags) / sizeof(StatusFlag))
+
+// Status words are 16 bits on the wire and in SavedStatus, so a status on
+// a higher bit is a compile error rather than one that never shows.
+#define TUBE_STATUS(bit, severity, icon, label) typedef char status_bit_##bit##_fits[(bit) < 16 ? 1 : -1];
+#include "tube-statuses.def"
+#undef TUBE_STATUS
+
+// The last applied snapshot as it is written to the status store.
+typedef struct {
+  uint8_t version;
+  uint32_t snapshot_id;
+  uint32_t manifest_version;
+  PblTm fetched;
+  uint8_t count;
+  uint8_t order[MAX_LINES];
+  uint16_t statuses[MAX_LINES];
+} SavedStatus;
+
 static void window_load(Window *me);
 static void window_unload(Window *me);
+static void window_appear(Window *me);
+static void window_disappear(Window *me);
+static void build_window();
+static void reload_menu();
+static void redraw_menu();
 static void init_menu(Window* wnd);
-static void load_bitmaps();
-static void unload_bitmaps();
+static void load_resources();
+static void unload_resources();
 static uint16_t menu_get_num_sections_callback(MenuLayer *me, void *data);
 static uint16_t menu_get_num_rows_callback(MenuLayer *me, uint16_t section_index, void *data);
 static int16_t menu_get_header_height_callback(MenuLayer *me, uint16_t section_index, void *data);
 static int16_t menu_get_cell_height_callback(MenuLayer *me, MenuIndex* cell_index, void *data);
 static void menu_draw_header_callback(GContext* ctx, const Layer *cell_layer, uint16_t section_index, void *data);
+static void draw_time_header(GContext* ctx, const Layer* cell_layer, const char* format_24h, const char* format_12h);
 static void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data);
 static void menu_draw_line_row(GContext* layer, const Layer* cell_layer, MenuIndex* cell_index);
 static void menu_select_click_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+static void menu_select_long_click_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
 static void do_status_request();
-static int xatoi (char** str, long* res);
-static int NumberOfSetBits(int i);
-static TubeLine* get_line_by_code(const char* code);
-static TubeLine* get_line_by_pos(int pos);
-static void draw_tube_line(GContext* ctx, const Layer* cell_layer, TubeLine* line);
+static void schedule_refresh();
+static void cancel_refresh();
+static uint32_t get_refresh_interval();
+static void write_status_request(DictionaryIterator* body);
+static void status_request_changed(int32_t cookie, RequestState request_state);
+static void save_status();
+static void saved_status_loaded(const uint8_t* data, uint16_t length);
+static void apply_snapshot(const StatusSnapshot* snapshot);
+static uint8_t get_line_by_row(int row);
+static bool is_filtering();
+static void update_visible_rows();
+static void toggle_watched(uint8_t line);
+static void save_watched();
+static void watched_loaded(const uint8_t* data, uint16_t length);
+static void update_watched_from_codes();
+static void manifest_updated(bool changed);
+static void reset_lines();
+static void update_line_order();
+static void draw_tube_line(GContext* ctx, const Layer* cell_layer, uint8_t line);
+static void update_render_cache();
+static bool apply_status_changes(const uint32_t* old_statuses, bool had_fresh_status);
+static uint8_t status_severity(uint32_t status);
+static void update_line_render(uint8_t line);
+static void append_status_label(TubeLineRender* render, const StatusFlag* flag);
+static void set_status_label(TubeLineRender* render, const char* label, uint8_t icon);
+static void format_since(char* buffer, uint8_t size, uint32_t minute, bool seen_start);
+static void saved_history_loaded();
+static void update_digest();
 static void draw_tfl_single_line(GContext* ctx, char* text);
 
 static Window window;
 static MenuLayer layer_menu;
-static HeapBitmap menu_icons[NUM_ICONS];
+static GBitmap* icon_atlas = NULL;
+static GBitmap menu_icons[NUM_ICONS];
 static GFont fonts[2];
 static int state = STATE_UPDATING;
-static const char* default_line_order = "BLCECIDIDLHCJLMENOOVPIVIWC";
-static bool loaded = false;
-
-static TubeLine lines[] = {
-  { "BL\0", 0, "Bakerloo", 0 },
-  { "CE\0", 0, "Central", 1 },
-  { "CI\0", 0, "Circle", 2 },
-  { "DI\0", 0, "District", 3 },
-  { "DL\0", 0, "DLR", 4 },
-  { "HC\0", 0, "H'smith & City", 5 },
-  { "JL\0", 0, "Jubilee", 6 },
-  { "ME\0", 0, "Metropolitan", 7 },
-  { "NO\0", 0, "Northern", 8 },
-  { "OV\0", 0, "Overground", 9 },
-  { "PI\0", 0, "Picadilly", 10 },
-  { "VI\0", 0, "Victoria", 11 },
-  { "WC\0", 0, "Waterloo & City", 12 }
+static uint32_t snapshot_id = 0;
+static bool has_status = false;
+// Set once the server has answered in this run, unlike has_status, which
+// a snapshot restored from the store sets as well.
+static bool has_fresh_status = false;
+static PblTm last_updated;
+static AppContextRef app_ctx;
+static AppTimerHandle refresh_timer = 0;
+static bool visible = false;
+static bool window_built = false;
+static bool awaiting_manifest = false;
+static bool show_diagnostics = false;
+
+static const ScheduledRequest status_request = {
+  .cookie = HTTP_TUBE_STATUS,
+  .url = API_BASE_URL "/london-tube/v2/status.php",
+  .write_body = write_status_request,
+  .success = wnd_tube_http_success,
+  .failure = wnd_tube_http_failure,
+  .state_changed = status_request_changed
 };
 
+// Per line state, indexed the same way as the line manifest.
+static uint32_t line_statuses[MAX_LINES];
+static uint8_t line_orderings[MAX_LINES];
+static TubeLineRender line_renders[MAX_LINES];
+static uint8_t lines_by_pos[MAX_LINES];
+
+// Watched lines are a bitmask over the manifest. While it is set, and
+// unless show_all is on, only those lines are requested and listed. The
+// codes are kept as well so the set survives a change of manifest.
+static uint32_t watched_lines = 0;
+static char watched_codes[MAX_LINES * 2 + 1] = "";
+static bool show_all = false;
+static uint8_t visible_rows[MAX_LINES];
+static uint8_t visible_count = 0;
+
+// One line summary for the main menu, rebuilt whenever the statuses or
+// the watched lines change so drawing it costs nothing.
+static char digest[32] = "";
+
+// Played when a watched line gets worse, so it can be told apart from the
+// system notification buzz.
+static const uint32_t worse_vibe_segments[] = { 100, 100, 100, 100, 400 };
+
 /**
  PUBLIC FUNCTIONS
  **/
 
-void wnd_tube_status_init() {
-  window_init(&window, "London Transport Window");
-  window_set_window_handlers(&window, (WindowHandlers){
-    .load = window_load,
-    .unload = window_unload
-  });
+void wnd_tube_status_init(AppContextRef ctx) {
+  app_ctx = ctx;
+  request_scheduler_register(&status_request);
 
-  init_menu(&window);
-
-  fonts[FONT_ROW_HEADER] = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_TFL_BOLD_18));
-  fonts[FONT_ROW_BODY] = fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_TFL_15));
+  line_manifest_init(manifest_updated);
+  reset_lines();
+  status_store_load(STATUS_STORE_SNAPSHOT, saved_status_loaded);
+  status_store_load(STATUS_STORE_WATCHED, watched_loaded);
+  status_history_init(saved_history_loaded);
 }
 
 void wnd_tube_status_show() {
+  if (! window_built) {
+    build_window();
+  }
   window_stack_push(&window, true);
 }
 
+const char* wnd_tube_status_digest() {
+  return digest;
+}
+
+void wnd_tube_status_refresh_timer() {
+  refresh_timer = 0;
+  if (visible) {
+    do_status_request();
+  }
+}
+
 void wnd_tube_http_failure(int32_t cookie, int http_status, void* context) {
   state = STATE_ERROR;
-  menu_layer_reload_data(&layer_menu);
+  redraw_menu();
+  schedule_refresh();
 }
 
 void wnd_tube_http_success(int32_t cookie, int http_status, DictionaryIterator* received, void* context) {
-  Tuple* tuple_order = dict_find(received, 0);
-  Tuple* tuple_statuses = dict_find(received, 1);
+  StatusSnapshot parsed;
+  StatusParseResult result = status_parser_parse(received, line_manifest_version(), line_manifest_count(), line_manifest_find, &parsed);
+  diagnostics_count(DIAG_PARSES);
 
-  const char* order = tuple_order->value->cstring;
-  const char* statuses = tuple_statuses->value->cstring;
+  // A response for a different manifest is dropped, the new manifest is
+  // fetched and the statuses requested again once it arrives. If lines.php
+  // couldn't serve that version the response counts as malformed.
+  if (result == STATUS_PARSE_MANIFEST_MISMATCH && line_manifest_check(parsed.manifest_version)) {
+    awaiting_manifest = true;
+    return;
+  }
+  // A malformed response is treated like a failed request, and the next
+  // request asks for a full update.
+  if (result != STATUS_PARSE_OK) {
+    diagnostics_count(DIAG_PARSE_ERRORS);
+    snapshot_id = 0;
+    wnd_tube_http_failure(cookie, http_status, context);
+    return;
+  }
 
-  for (int l = 0; l < NUM_LINES; l += 1) {
-    char code_str[3];
-    long status_num;
-    char* status_str = "000";
+  uint32_t old_statuses[MAX_LINES];
+  uint8_t old_rows[MAX_LINES];
+  uint8_t old_visible_count = visible_count;
+  memcpy(old_statuses, line_statuses, sizeof(old_statuses));
+  memcpy(old_rows, visible_rows, sizeof(old_rows));
 
-    strncpy(code_str, order + (l * 2), 2);
-    strncpy(status_str, statuses + (l * 3), 3);
-    xatoi(&status_str, &status_num);
+  apply_snapshot(&parsed);
+  snapshot_id = parsed.snapshot_id;
+  // This and save_status() below both write a cookie. The store sends
+  // them one after the other.
+  status_history_record(line_manifest_version(), line_statuses, line_manifest_count());
 
-    TubeLine* line = get_line_by_code(code_str);
-    if (! line) {
-      vibes_short_pulse();
-      continue;
-    }
-    line->ordering = l;
-    line->status = (int)status_num;
-  }
+  // The header always changes, but the rows only need laying out again if
+  // the order or a row's height did.
+  bool relayout = apply_status_changes(old_statuses, has_fresh_status);
+  relayout = relayout || visible_count != old_visible_count || memcmp(visible_rows, old_rows, visible_count) != 0;
+  get_time(&last_updated);
+  has_status = true;
+  has_fresh_status = true;
   state = STATE_OK;
-  menu_layer_reload_data(&layer_menu);
+  update_digest();
+  if (relayout) {
+    reload_menu();
+  }
+  else {
+    redraw_menu();
+  }
+  save_status();
+  schedule_refresh();
 }
 
 /**
@@ -157,23 +331,71 @@ void wnd_tube_http_success(int32_t cookie, int http_status, DictionaryIterator*
  **/
 
 void window_load(Window* me) {
-  load_bitmaps();
+  load_resources();
   do_status_request();
 }
 
 void window_unload(Window* me) {
-  unload_bitmaps();
+  cancel_refresh();
+  unload_resources();
 }
 
-void load_bitmaps() {
-  heap_bitmap_init(&menu_icons[MENU_ICON_OK], RESOURCE_ID_MENU_OK);
-  heap_bitmap_init(&menu_icons[MENU_ICON_PROBLEM], RESOURCE_ID_MENU_PROBLEM);
-  heap_bitmap_init(&menu_icons[MENU_ICON_UNKNOWN], RESOURCE_ID_MENU_UNKNOWN);
+void window_appear(Window* me) {
+  visible = true;
+  if (state != STATE_UPDATING) {
+    schedule_refresh();
+  }
 }
 
-void unload_bitmaps() {
-  for (int icon = 0; icon < NUM_ICONS; icon += 1) {
-    heap_bitmap_deinit(&menu_icons[icon]);
+void window_disappear(Window* me) {
+  visible = false;
+  cancel_refresh();
+}
+
+void load_resources() {
+  fonts[FONT_ROW_HEADER] = font_manager_get_font(RESOURCE_ID_FONT_TFL_BOLD_18);
+  fonts[FONT_ROW_BODY] = font_manager_get_font(RESOURCE_ID_FONT_TFL_15);
+  icon_atlas = font_manager_get_bitmap(RESOURCE_ID_ICON_ATLAS);
+  if (icon_atlas) {
+    gbitmap_init_as_sub_bitmap(&menu_icons[MENU_ICON_OK], icon_atlas, ICON_ATLAS_STATUS_OK);
+    gbitmap_init_as_sub_bitmap(&menu_icons[MENU_ICON_PROBLEM], icon_atlas, ICON_ATLAS_STATUS_PROBLEM);
+    gbitmap_init_as_sub_bitmap(&menu_icons[MENU_ICON_UNKNOWN], icon_atlas, ICON_ATLAS_STATUS_UNKNOWN);
+  }
+}
+
+void unload_resources() {
+  font_manager_release(RESOURCE_ID_FONT_TFL_BOLD_18);
+  font_manager_release(RESOURCE_ID_FONT_TFL_15);
+  font_manager_release(RESOURCE_ID_ICON_ATLAS);
+  icon_atlas = NULL;
+}
+
+// The window and its menu are only built the first time they are shown,
+// which keeps them out of app launch.
+void build_window() {
+  window_init(&window, "London Transport Window");
+  window_set_window_handlers(&window, (WindowHandlers){
+    .load = window_load,
+    .unload = window_unload,
+    .appear = window_appear,
+    .disappear = window_disappear
+  });
+  init_menu(&window);
+  window_built = true;
+}
+
+void reload_menu() {
+  if (window_built) {
+    diagnostics_count(DIAG_RELAYOUTS);
+    menu_layer_reload_data(&layer_menu);
+  }
+}
+
+// Redraws the rows without asking for their heights again.
+void redraw_menu() {
+  if (window_built) {
+    diagnostics_count(DIAG_REDRAWS);
+    layer_mark_dirty(menu_layer_get_layer(&layer_menu));
   }
 }
 
@@ -186,7 +408,8 @@ void init_menu(Window* wnd) {
     .get_cell_height = menu_get_cell_height_callback,
     .draw_header = menu_draw_header_callback,
     .draw_row = menu_draw_row_callback,
-    .select_click = menu_select_click_callback
+    .select_click = menu_select_click_callback,
+    .select_long_click = menu_select_long_click_callback
   });
   menu_layer_set_click_config_onto_window(&layer_menu, wnd);
   layer_add_child(&wnd->layer, menu_layer_get_layer(&layer_menu));
@@ -194,24 +417,135 @@ void init_menu(Window* wnd) {
 
 void do_status_request() {
   state = STATE_UPDATING;
-  menu_layer_reload_data(&layer_menu);
+  redraw_menu();
+  request_scheduler_send(HTTP_TUBE_STATUS);
+}
 
-  DictionaryIterator* body;
-  HTTPResult result = http_out_get("http://api.pblweb.com/london-tube/v2/status.php", HTTP_TUBE_STATUS, &body);
-  if (result != HTTP_OK) {
-    state = STATE_ERROR;
-    menu_layer_reload_data(&layer_menu);
-    return;
+// Only runs while the window is on top. Called again after every refresh
+// completes so the interval follows the latest statuses.
+void schedule_refresh() {
+  cancel_refresh();
+  if (visible) {
+    refresh_timer = app_timer_send_event(app_ctx, get_refresh_interval(), TIMER_TUBE_REFRESH);
   }
+}
 
-  dict_write_cstring(body, 0, default_line_order);
-  dict_write_int32(body, 1, 1);
+void cancel_refresh() {
+  if (refresh_timer) {
+    app_timer_cancel_event(app_ctx, refresh_timer);
+    refresh_timer = 0;
+  }
+}
 
-  result = http_out_send();
-  if (result != HTTP_OK) {
-    state = STATE_ERROR;
-    menu_layer_reload_data(&layer_menu);
+// Refresh more often while something is wrong, less often when everything
+// has a good service, and rarely while the tube is closed (00:30 - 05:30).
+uint32_t get_refresh_interval() {
+  PblTm now;
+  get_time(&now);
+  int minute_of_day = now.tm_hour * 60 + now.tm_min;
+  if (minute_of_day >= 30 && minute_of_day < 330) {
+    return REFRESH_CLOSED_MS;
+  }
+  for (uint8_t r = 0; r < visible_count; r += 1) {
+    if (line_statuses[visible_rows[r]] & ~STATUS_GOOD_SERVICE) {
+      return REFRESH_DISRUPTED_MS;
+    }
+  }
+  return REFRESH_GOOD_MS;
+}
+
+void write_status_request(DictionaryIterator* body) {
+  dict_write_int32(body, KEY_VERSION, STATUS_FORMAT_VERSION);
+  dict_write_uint32(body, KEY_MANIFEST, line_manifest_version());
+  if (is_filtering()) {
+    dict_write_uint32(body, KEY_WATCHED, watched_lines);
+  }
+  if (snapshot_id != 0) {
+    dict_write_uint32(body, KEY_SNAPSHOT, snapshot_id);
+  }
+}
+
+void status_request_changed(int32_t cookie, RequestState request_state) {
+  if (request_state == REQUEST_RETRY_WAIT) {
+    redraw_menu();
+  }
+}
+
+void apply_snapshot(const StatusSnapshot* snapshot) {
+  switch (snapshot->update_type) {
+    case STATUS_UPDATE_UNCHANGED:
+    break;
+    case STATUS_UPDATE_DELTA:
+      for (uint8_t c = 0; c < snapshot->count; c += 1) {
+        line_statuses[snapshot->lines[c]] = snapshot->statuses[c];
+      }
+    break;
+    default: {
+      // A full update can list only some lines, e.g. just the watched
+      // ones. Those take the first positions in the server's order and the
+      // rest follow them in the order they had.
+      bool listed[MAX_LINES] = { false };
+      for (uint8_t p = 0; p < snapshot->count; p += 1) {
+        listed[snapshot->lines[p]] = true;
+      }
+      uint8_t next_pos = snapshot->count;
+      for (uint8_t p = 0; p < line_manifest_count(); p += 1) {
+        if (! listed[lines_by_pos[p]]) {
+          line_orderings[lines_by_pos[p]] = next_pos;
+          next_pos += 1;
+        }
+      }
+      for (uint8_t p = 0; p < snapshot->count; p += 1) {
+        line_orderings[snapshot->lines[p]] = p;
+        line_statuses[snapshot->lines[p]] = snapshot->statuses[p];
+      }
+      update_line_order();
+    }
+    break;
+  }
+}
+
+void save_status() {
+  SavedStatus saved;
+  saved.version = SAVED_STATUS_VERSION;
+  saved.snapshot_id = snapshot_id;
+  saved.manifest_version = line_manifest_version();
+  saved.fetched = last_updated;
+  saved.count = line_manifest_count();
+  for (uint8_t l = 0; l < saved.count; l += 1) {
+    saved.order[l] = line_orderings[l];
+    saved.statuses[l] = line_statuses[l];
   }
+  status_store_save(STATUS_STORE_SNAPSHOT, (uint8_t*)&saved, sizeof(saved));
+}
+
+// Shows the snapshot from the last run straight away. The header keeps it
+// marked as stale until a fresh response arrives, and a fresh response
+// that beat the store to it is never overwritten.
+void saved_status_loaded(const uint8_t* data, uint16_t length) {
+  if (has_status || length != sizeof(SavedStatus)) {
+    return;
+  }
+  SavedStatus saved;
+  memcpy(&saved, data, sizeof(saved));
+  // The manifest is loaded from the store first, so a snapshot taken
+  // against any other manifest is out of date.
+  if (saved.version != SAVED_STATUS_VERSION || saved.manifest_version != line_manifest_version() || saved.count != line_manifest_count()) {
+    return;
+  }
+
+  for (uint8_t l = 0; l < saved.count; l += 1) {
+    line_orderings[l] = saved.order[l];
+    line_statuses[l] = saved.statuses[l];
+  }
+  snapshot_id = saved.snapshot_id;
+  last_updated = saved.fetched;
+  has_status = true;
+  update_digest();
+
+  update_line_order();
+  update_render_cache();
+  reload_menu();
 }
 
 uint16_t menu_get_num_sections_callback(MenuLayer *me, void *data) {
@@ -221,10 +555,10 @@ uint16_t menu_get_num_sections_callback(MenuLayer *me, void *data) {
 uint16_t menu_get_num_rows_callback(MenuLayer *me, uint16_t section_index, void *data) {
   switch (section_index) {
     case SECTION_LINES:
-      return NUM_LINES;
+      return visible_count;
     break;
     case SECTION_OPTIONS:
-      return 1;
+      return show_diagnostics ? NUM_OPTIONS + 1 : NUM_OPTIONS;
     break;
   }
   return 0;
@@ -235,9 +569,10 @@ int16_t menu_get_header_height_callback(MenuLayer *me, uint16_t section_index, v
 }
 
 int16_t menu_get_cell_height_callback(MenuLayer *me, MenuIndex* cell_index, void *data) {
+  diagnostics_count(DIAG_HEIGHT_CALLS);
   switch (cell_index->section) {
     case SECTION_LINES:
-      return max(40, 24 + (16 * NumberOfSetBits(get_line_by_pos(cell_index->row)->status)));
+      return line_renders[get_line_by_row(cell_index->row)].row_height;
     break;
     case SECTION_OPTIONS:
       return 40;
@@ -251,23 +586,31 @@ void menu_draw_header_callback(GContext* ctx, const Layer *cell_layer, uint16_t
     case SECTION_LINES: {
       switch (state) {
         case STATE_UPDATING:
-          menu_cell_basic_header_draw(ctx, cell_layer, "Updating...");
-        break;
-        case STATE_OK: {
-          char time_str[50];
-          PblTm now;
-          get_time(&now);
-          if (clock_is_24h_style()) {
-            string_format_time(time_str, sizeof(time_str), "Last Updated: %H:%M", &now);
+          if (request_scheduler_state(HTTP_TUBE_STATUS) == REQUEST_RETRY_WAIT) {
+            if (has_status) {
+              draw_time_header(ctx, cell_layer, "Retrying, from %H:%M", "Retrying, from %l:%M %p");
+            }
+            else {
+              menu_cell_basic_header_draw(ctx, cell_layer, "Retrying...");
+            }
+          }
+          else if (has_status) {
+            draw_time_header(ctx, cell_layer, "Updating, from %H:%M", "Updating, from %l:%M %p");
           }
           else {
-            string_format_time(time_str, sizeof(time_str), "Last Updated: %l:%M %p", &now);
+            menu_cell_basic_header_draw(ctx, cell_layer, "Updating...");
           }
-          menu_cell_basic_header_draw(ctx, cell_layer, time_str);
-        }
+        break;
+        case STATE_OK:
+          draw_time_header(ctx, cell_layer, "Last Updated: %H:%M", "Last Updated: %l:%M %p");
         break;
         case STATE_ERROR:
-          menu_cell_basic_header_draw(ctx, cell_layer, "Updating Failed");
+          if (has_status) {
+            draw_time_header(ctx, cell_layer, "Failed, from %H:%M", "Failed, from %l:%M %p");
+          }
+          else {
+            menu_cell_basic_header_draw(ctx, cell_layer, "Updating Failed");
+          }
         break;
       }
     }
@@ -278,34 +621,67 @@ void menu_draw_header_callback(GContext* ctx, const Layer *cell_layer, uint16_t
   }
 }
 
+void draw_time_header(GContext* ctx, const Layer* cell_layer, const char* format_24h, const char* format_12h) {
+  char time_str[50];
+  string_format_time(time_str, sizeof(time_str), clock_is_24h_style() ? format_24h : format_12h, &last_updated);
+  menu_cell_basic_header_draw(ctx, cell_layer, time_str);
+}
+
 void menu_draw_row_callback(GContext* ctx, const Layer *cell_layer, MenuIndex *cell_index, void *data) {
+  diagnostics_count(DIAG_ROW_DRAWS);
   switch (cell_index->section) {
     case SECTION_LINES:
       menu_draw_line_row(ctx, cell_layer, cell_index);
     break;
     case SECTION_OPTIONS: {
       switch (cell_index->row) {
-        case 0:
+        case OPTION_REFRESH:
           draw_tfl_single_line(ctx, "Refresh Lines");
         break;
+        case OPTION_SHOW_ALL:
+          if (watched_lines == 0) {
+            draw_tfl_single_line(ctx, "Hold a Line to Watch");
+          }
+          else {
+            draw_tfl_single_line(ctx, show_all ? "Show Watched" : "Show All Lines");
+          }
+        break;
+        case OPTION_DIAGNOSTICS:
+          draw_tfl_single_line(ctx, "Diagnostics");
+        break;
       }
     }
   }
 }
 
 void menu_draw_line_row(GContext* ctx, const Layer* cell_layer, MenuIndex* cell_index) {
-  draw_tube_line(ctx, cell_layer, get_line_by_pos(cell_index->row));
+  draw_tube_line(ctx, cell_layer, get_line_by_row(cell_index->row));
 }
 
 void menu_select_click_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
   switch (cell_index->section) {
-    case 1: {
+    case SECTION_LINES: {
+      uint8_t line = get_line_by_row(cell_index->row);
+      if (line_statuses[line] & ~STATUS_GOOD_SERVICE) {
+        wnd_line_detail_show(line_manifest_code(line), line_manifest_name(line), line_statuses[line]);
+      }
+    }
+    break;
+    case SECTION_OPTIONS: {
       switch (cell_index->row) {
-        case 0: {
+        case OPTION_REFRESH:
           do_status_request();
-          MenuIndex index =  { 0, 0 };
-          menu_layer_set_selected_index(menu_layer, index, MenuRowAlignBottom, false);
-        }
+        break;
+        case OPTION_SHOW_ALL:
+          if (watched_lines != 0) {
+            show_all = ! show_all;
+            snapshot_id = 0;
+            update_visible_rows();
+            do_status_request();
+          }
+        break;
+        case OPTION_DIAGNOSTICS:
+          wnd_diagnostics_show();
         break;
       }
     }
@@ -313,91 +689,174 @@ void menu_select_click_callback(MenuLayer *menu_layer, MenuIndex *cell_index, vo
   }
 }
 
+// Holding select on a line adds it to or removes it from the watched set.
+// Holding it on Refresh Lines shows or hides the diagnostics row.
+void menu_select_long_click_callback(MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
+  switch (cell_index->section) {
+    case SECTION_LINES:
+      toggle_watched(get_line_by_row(cell_index->row));
+    break;
+    case SECTION_OPTIONS:
+      if (cell_index->row == OPTION_REFRESH) {
+        show_diagnostics = ! show_diagnostics;
+        reload_menu();
+      }
+    break;
+  }
+}
 
-void draw_tube_line(GContext* ctx, const Layer* cell_layer, TubeLine* line) {
-  char status_label[100] = "";
-  GBitmap* bmp;
 
-  strcpy(status_label, "");
+void draw_tube_line(GContext* ctx, const Layer* cell_layer, uint8_t line) {
+  TubeLineRender* render = &line_renders[line];
+  graphics_context_set_text_color(ctx, GColorBlack);
+  if (icon_atlas) {
+    graphics_draw_bitmap_in_rect(ctx, &menu_icons[render->icon], GRect(4, 22, 12, 14));
+  }
+  graphics_text_draw(ctx, line_manifest_name(line), fonts[FONT_ROW_HEADER], GRect(4, 0, 140, 18), 0, GTextAlignmentLeft, NULL);
+  if (watched_lines & ((uint32_t)1 << line)) {
+    graphics_context_set_fill_color(ctx, GColorBlack);
+    graphics_fill_circle(ctx, GPoint(134, 9), 3);
+  }
+  graphics_text_draw(ctx, render->label, fonts[FONT_ROW_BODY], GRect(22, LABEL_TOP, 116, render->label_height), 0, GTextAlignmentLeft, NULL);
+  if (render->since[0]) {
+    graphics_text_draw(ctx, render->since, fonts_get_system_font(FONT_KEY_GOTHIC_14), GRect(22, LABEL_TOP + render->label_height, 116, SINCE_HEIGHT), 0, GTextAlignmentLeft, NULL);
+  }
+}
 
-  for (int s = 2; s <= 256; s *= 2) {
-    if (line->status & s) {
-      switch (s) {
-        case 2:
-          if (strlen(status_label) > 0) {
-            strcat(status_label, "\n");
-          }
-          strcat(status_label, "Minor Delays");
-        break;
-        case 4:
-          if (strlen(status_label) > 0) {
-            strcat(status_label, "\n");
-          }
-          strcat(status_label, "Bus Service");
-        break;
-        case 8:
-          if (strlen(status_label) > 0) {
-            strcat(status_label, "\n");
-          }
-          strcat(status_label, "Reduced Service");
-        break;
-        case 16:
-          if (strlen(status_label) > 0) {
-            strcat(status_label, "\n");
-          }
-          strcat(status_label, "Severe Delays");
-        break;
-        case 32:
-          if (strlen(status_label) > 0) {
-            strcat(status_label, "\n");
-          }
-          strcat(status_label, "Part Closure");
-        break;
-        case 64:
-          if (strlen(status_label) > 0) {
-            strcat(status_label, "\n");
-          }
-          strcat(status_label, "Planned Closure");
-        break;
-        case 128:
-          if (strlen(status_label) > 0) {
-            strcat(status_label, "\n");
-          }
-          strcat(status_label, "Part Suspended");
-        break;
-        case 256:
-          if (strlen(status_label) > 0) {
-            strcat(status_label, "\n");
-          }
-          strcat(status_label, "Suspended");
-        break;
-      }
+// The label and icon for a line only change when a new status arrives, so
+// they are built once per update here rather than on every draw.
+void update_render_cache() {
+  for (uint8_t l = 0; l < line_manifest_count(); l += 1) {
+    update_line_render(l);
+  }
+}
+
+// Rebuilds the render cache of the lines whose status changed, and buzzes
+// if a watched line got worse than it was. Nothing buzzes until the server
+// has answered once this run, since a restored snapshot may be hours old.
+// Returns whether any row changed height.
+bool apply_status_changes(const uint32_t* old_statuses, bool had_fresh_status) {
+  bool relayout = false;
+  bool got_worse = false;
+  for (uint8_t l = 0; l < line_manifest_count(); l += 1) {
+    if (line_statuses[l] == old_statuses[l]) {
+      continue;
+    }
+    uint8_t old_height = line_renders[l].row_height;
+    update_line_render(l);
+    relayout = relayout || line_renders[l].row_height != old_height;
+    if (had_fresh_status && (watched_lines & ((uint32_t)1 << l)) &&
+      status_severity(line_statuses[l]) > status_severity(old_statuses[l])) {
+      got_worse = true;
     }
   }
+  if (got_worse) {
+    vibes_enqueue_custom_pattern((VibePattern){
+      .durations = worse_vibe_segments,
+      .num_segments = sizeof(worse_vibe_segments) / sizeof(uint32_t)
+    });
+  }
+  return relayout;
+}
 
-  if (strlen(status_label) == 0) {
-    switch (line->status) {
-      case 0:
-        strcpy(status_label, "Getting Status");
-        bmp = &menu_icons[MENU_ICON_UNKNOWN].bmp;
-      break;
-      case 1:
-        strcpy(status_label, "Good Service");
-        bmp = &menu_icons[MENU_ICON_OK].bmp;
-      break;
-      default:
-        strcpy(status_label, "Unknown Status");
-        bmp = &menu_icons[MENU_ICON_UNKNOWN].bmp;
+// Bits missing from the table are treated as minor problems.
+uint8_t status_severity(uint32_t status) {
+  uint8_t severity = SEVERITY_NONE;
+  uint32_t known = 0;
+  for (uint8_t f = 0; f < NUM_STATUS_FLAGS; f += 1) {
+    uint32_t mask = (uint32_t)1 << status_flags[f].bit;
+    known |= mask;
+    if ((status & mask) && status_flags[f].severity > severity) {
+      severity = status_flags[f].severity;
     }
   }
-  else {
-    bmp = &menu_icons[MENU_ICON_PROBLEM].bmp;
+  if ((status & ~known) && severity < SEVERITY_MINOR) {
+    severity = SEVERITY_MINOR;
   }
+  return severity;
+}
 
-  graphics_context_set_text_color(ctx, GColorBlack);
-  graphics_draw_bitmap_in_rect(ctx, bmp, GRect(4, 22, 12, 14));
-  graphics_text_draw(ctx, line->name, fonts[FONT_ROW_HEADER], GRect(4, 0, 140, 18), 0, GTextAlignmentLeft, NULL);
-  graphics_text_draw(ctx, status_label, fonts[FONT_ROW_BODY], GRect(22, 19, 116, max(18, (18 * NumberOfSetBits(line->status)))), 0, GTextAlignmentLeft, NULL);
+// Good Service is only shown when it is the only flag set, otherwise the
+// labels of every other flag are listed and the icon comes from the most
+// severe of them.
+void update_line_render(uint8_t line) {
+  TubeLineRender* render = &line_renders[line];
+  uint32_t status = line_statuses[line];
+  render->label[0] = '\0';
+  render->label_length = 0;
+  render->label_height = 0;
+  int8_t severity = -1;
+
+  for (uint8_t f = 0; f < NUM_STATUS_FLAGS; f += 1) {
+    const StatusFlag* flag = &status_flags[f];
+    uint32_t mask = (uint32_t)1 << flag->bit;
+    if (! (status & mask)) {
+      continue;
+    }
+    if (flag->severity == SEVERITY_NONE && status != mask) {
+      continue;
+    }
+    append_status_label(render, flag);
+    if (flag->severity > severity) {
+      render->icon = flag->icon;
+      severity = flag->severity;
+    }
+  }
+
+  if (render->label_height == 0) {
+    set_status_label(render, status == 0 ? "Getting Status" : "Unknown Status", MENU_ICON_UNKNOWN);
+  }
+
+  uint32_t since_minute;
+  bool seen_start;
+  render->since[0] = '\0';
+  if ((status & ~STATUS_GOOD_SERVICE) && status_history_since(line_manifest_version(), line, status, &since_minute, &seen_start)) {
+    format_since(render->since, sizeof(render->since), since_minute, seen_start);
+  }
+  render->row_height = max(ROW_MIN_HEIGHT, LABEL_TOP + render->label_height + (render->since[0] ? SINCE_HEIGHT : 0) + 3);
+}
+
+// Labels that would not fit in the buffer are dropped.
+void append_status_label(TubeLineRender* render, const StatusFlag* flag) {
+  uint8_t length = render->label_length;
+  if (length > 0) {
+    if (length + 1 + flag->label_length >= STATUS_LABEL_LENGTH) {
+      return;
+    }
+    render->label[length] = '\n';
+    length += 1;
+  }
+  memcpy(render->label + length, flag->label, flag->label_length + 1);
+  render->label_length = length + flag->label_length;
+  render->label_height += LABEL_LINE_HEIGHT;
+}
+
+void set_status_label(TubeLineRender* render, const char* label, uint8_t icon) {
+  strcpy(render->label, label);
+  render->label_length = strlen(label);
+  render->label_height = LABEL_LINE_HEIGHT;
+  render->icon = icon;
+}
+
+// Shows the time of day the status started, or that it is older than the
+// history goes back. The render cache is only rebuilt when a status
+// changes, so a clock time is used rather than an age that would go stale.
+void format_since(char* buffer, uint8_t size, uint32_t minute, bool seen_start) {
+  uint32_t now = status_history_now();
+  if (now < minute || now - minute >= 24 * 60) {
+    strncpy(buffer, "For over a day", size);
+    return;
+  }
+  PblTm since;
+  since.tm_hour = (minute / 60) % 24;
+  since.tm_min = minute % 60;
+  since.tm_sec = 0;
+  if (seen_start) {
+    string_format_time(buffer, size, clock_is_24h_style() ? "Since %H:%M" : "Since %l:%M %p", &since);
+  }
+  else {
+    string_format_time(buffer, size, clock_is_24h_style() ? "Since before %H:%M" : "Since before %l:%M %p", &since);
+  }
 }
 
 void draw_tfl_single_line(GContext* ctx, char* text) {
@@ -405,84 +864,176 @@ void draw_tfl_single_line(GContext* ctx, char* text) {
   graphics_text_draw(ctx, text, fonts[FONT_ROW_HEADER], GRect(8, 8, 140, 18), 0, GTextAlignmentLeft, NULL);
 }
 
-TubeLine* get_line_by_code(const char* code) {
-  for (int l = 0; l < NUM_LINES; l += 1) {
-    if (strncmp(lines[l].code, code, 2) == 0) {
-      return &lines[l];
+uint8_t get_line_by_row(int row) {
+  return visible_rows[row];
+}
+
+bool is_filtering() {
+  return watched_lines != 0 && ! show_all;
+}
+
+// Lists the lines that have rows, in display order.
+void update_visible_rows() {
+  visible_count = 0;
+  for (uint8_t p = 0; p < line_manifest_count(); p += 1) {
+    uint8_t line = lines_by_pos[p];
+    if (! is_filtering() || (watched_lines & ((uint32_t)1 << line))) {
+      visible_rows[visible_count] = line;
+      visible_count += 1;
     }
   }
-  return NULL;
 }
 
-TubeLine* get_line_by_pos(int pos) {
-  for (int l = 0; l < NUM_LINES; l += 1) {
-    if (lines[l].ordering == pos) {
-      return &lines[l];
+// A line removed while filtering disappears from the list straight away,
+// and removing the last watched line shows every line again.
+void toggle_watched(uint8_t line) {
+  watched_lines ^= (uint32_t)1 << line;
+  if (watched_lines == 0) {
+    show_all = false;
+  }
+  snapshot_id = 0;
+  save_watched();
+  update_visible_rows();
+  update_digest();
+  reload_menu();
+}
+
+void save_watched() {
+  uint8_t length = 0;
+  for (uint8_t l = 0; l < line_manifest_count(); l += 1) {
+    if (watched_lines & ((uint32_t)1 << l)) {
+      memcpy(watched_codes + length, line_manifest_code(l), 2);
+      length += 2;
     }
   }
-  return NULL;
+  watched_codes[length] = '\0';
+  status_store_save(STATUS_STORE_WATCHED, (const uint8_t*)watched_codes, length);
 }
 
-/* This function is copied from the Embedded String Functions which
- * is available at http://elm-chan.org/fsw/strf/xprintf.html
- *
- * Since I'm only using it to convert to decimal numbers I should probably
- * rewrite it to make it simpler / more efficient.
- */
-int xatoi (char **str, long *res) {
-  unsigned long val;
-  unsigned char c, r, s = 0;
-
-  *res = 0;
-
-  while ((c = **str) == ' ') (*str)++;  /* Skip leading spaces */
-
-  if (c == '-') {   /* negative? */
-    s = 1;
-    c = *(++(*str));
-  }
-
-  if (c == '0') {
-    c = *(++(*str));
-    switch (c) {
-    case 'x':   /* hexdecimal */
-      r = 16; c = *(++(*str));
-      break;
-    case 'b':   /* binary */
-      r = 2; c = *(++(*str));
-      break;
-    default:
-      if (c <= ' ') return 1; /* single zero */
-      if (c < '0' || c > '9') return 0; /* invalid char */
-      r = 8;    /* octal */
+// Counts the lines with a problem, only looking at the watched lines if
+// there are any. Nothing is shown until there is a status, and the time
+// it is from is always shown, since it may be a snapshot from a past run.
+void update_digest() {
+  char new_digest[sizeof(digest)];
+  char time_str[12];
+  uint8_t disrupted = 0;
+  for (uint8_t l = 0; l < line_manifest_count(); l += 1) {
+    if ((line_statuses[l] & ~STATUS_GOOD_SERVICE) && (watched_lines == 0 || (watched_lines & ((uint32_t)1 << l)))) {
+      disrupted += 1;
     }
-  } else {
-    if (c < '0' || c > '9') return 0; /* EOL or invalid char */
-    r = 10;     /* decimal */
-  }
-
-  val = 0;
-  while (c > ' ') {
-    if (c >= 'a') c -= 0x20;
-    c -= '0';
-    if (c >= 17) {
-      c -= 7;
-      if (c <= 9) return 0; /* invalid char */
+  }
+  string_format_time(time_str, sizeof(time_str), clock_is_24h_style() ? "%H:%M" : "%l:%M %p", &last_updated);
+  if (! has_status) {
+    new_digest[0] = '\0';
+  }
+  else if (disrupted == 0) {
+    snprintf(new_digest, sizeof(new_digest), "%s good at %s", watched_lines ? "Watched" : "All", time_str);
+  }
+  else {
+    snprintf(new_digest, sizeof(new_digest), "%d disrupted at %s", disrupted, time_str);
+  }
+  if (strcmp(new_digest, digest) != 0) {
+    strcpy(digest, new_digest);
+    wnd_main_menu_refresh();
+  }
+}
+
+void saved_history_loaded() {
+  update_render_cache();
+  reload_menu();
+}
+
+void watched_loaded(const uint8_t* data, uint16_t length) {
+  if (length >= sizeof(watched_codes)) {
+    return;
+  }
+  memcpy(watched_codes, data, length);
+  watched_codes[length] = '\0';
+  update_watched_from_codes();
+  update_visible_rows();
+  update_digest();
+  reload_menu();
+}
+
+// Codes that are no longer in the manifest are dropped.
+void update_watched_from_codes() {
+  watched_lines = 0;
+  for (uint8_t c = 0; watched_codes[c] && watched_codes[c + 1]; c += 2) {
+    int line = line_manifest_find(watched_codes + c);
+    if (line >= 0) {
+      watched_lines |= (uint32_t)1 << line;
     }
-    if (c >= r) return 0;   /* invalid char for current radix */
-    val = val * r + c;
-    c = *(++(*str));
   }
-  if (s) val = 0 - val;     /* apply sign if needed */
+  if (watched_lines == 0) {
+    show_all = false;
+  }
+}
 
-  *res = val;
-  return 1;
+// The old statuses can't be matched up with the new lines, so they are
+// dropped and requested again if a request was waiting on the manifest.
+void manifest_updated(bool changed) {
+  if (changed) {
+    update_watched_from_codes();
+    reset_lines();
+    snapshot_id = 0;
+    has_status = false;
+    has_fresh_status = false;
+    update_digest();
+    reload_menu();
+  }
+  if (! awaiting_manifest) {
+    return;
+  }
+  awaiting_manifest = false;
+  if (changed) {
+    do_status_request();
+  }
+  else {
+    state = STATE_ERROR;
+    redraw_menu();
+    schedule_refresh();
+  }
 }
 
-int NumberOfSetBits(int i)
-{
-    i = i - ((i >> 1) & 0x55555555);
-    i = (i & 0x33333333) + ((i >> 2) & 0x33333333);
-    return (((i + (i >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+void reset_lines() {
+  for (uint8_t l = 0; l < MAX_LINES; l += 1) {
+    line_statuses[l] = 0;
+    line_orderings[l] = l;
+  }
+  update_line_order();
+  update_render_cache();
 }
 
+// Rebuilds the position to line table, and the rows shown, after the
+// orderings have changed. Any line whose ordering is out of range or
+// already taken is moved into the first free position so that every row
+// always has a line.
+void update_line_order() {
+  uint8_t count = line_manifest_count();
+  bool taken[MAX_LINES];
+  bool placed[MAX_LINES];
+  for (uint8_t p = 0; p < count; p += 1) {
+    taken[p] = false;
+  }
+  for (uint8_t l = 0; l < count; l += 1) {
+    uint8_t pos = line_orderings[l];
+    placed[l] = pos < count && ! taken[pos];
+    if (placed[l]) {
+      lines_by_pos[pos] = l;
+      taken[pos] = true;
+    }
+  }
+  uint8_t free_pos = 0;
+  for (uint8_t l = 0; l < count; l += 1) {
+    if (placed[l]) {
+      continue;
+    }
+    while (taken[free_pos]) {
+      free_pos += 1;
+    }
+    line_orderings[l] = free_pos;
+    lines_by_pos[free_pos] = l;
+    taken[free_pos] = true;
+  }
+  update_visible_rows();
+}
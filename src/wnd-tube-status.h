@@ -24,9 +24,12 @@
 #define WND_TUBE_STATUS_H
 
 #define HTTP_TUBE_STATUS 8823
+#define TIMER_TUBE_REFRESH 8824
 
-void wnd_tube_status_init();
+void wnd_tube_status_init(AppContextRef ctx);
 void wnd_tube_status_show();
+void wnd_tube_status_refresh_timer();
+const char* wnd_tube_status_digest();
 void wnd_tube_http_failure(int32_t cookie, int http_status, void* context);
 void wnd_tube_http_success(int32_t cookie, int http_status, DictionaryIterator* received, void* context);
 
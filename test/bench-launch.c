@@ -0,0 +1,130 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+#include "smallstone.h"
+#include "wnd-tube-status.h"
+#include "wnd-next-bus.h"
+#include "wnd-line-detail.h"
+
+// Times a launch, from stub_start_app() until the main menu has drawn its
+// first frame, with windows built on first show as the app does now and
+// with them all built at launch as it used to. The eager case builds each
+// window by showing and popping it straight after launch, which also
+// queues the windows' first requests, so it slightly overstates the old
+// cost. Every launch runs in a fresh process, since a window is only
+// built once per process. The stub draws nothing, so the layer, text
+// measurement and resource counts say more about the cost on the watch
+// than the times do.
+
+#define RUNS 200
+
+typedef struct {
+  double ns;
+  StubCounters counters;
+} LaunchResult;
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void build_every_window() {
+  create_thanks_window();
+  wnd_tube_status_show();
+  window_stack_pop(false);
+  wnd_next_bus_show();
+  window_stack_pop(false);
+  wnd_line_detail_show("BL", "Bakerloo", 1);
+  window_stack_pop(false);
+}
+
+static LaunchResult launch(bool eager) {
+  LaunchResult result;
+  stub_reset_counters();
+  double start = now_ns();
+  stub_start_app();
+  if (eager) {
+    build_every_window();
+  }
+  stub_menu_draw_frame();
+  result.ns = now_ns() - start;
+  result.counters = stub_counters;
+  return result;
+}
+
+// Runs each launch in a child and collects the results through a pipe.
+static bool measure(bool eager, LaunchResult* total) {
+  memset(total, 0, sizeof(*total));
+  for (int run = 0; run < RUNS; run += 1) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      return false;
+    }
+    pid_t child = fork();
+    if (child == 0) {
+      close(fds[0]);
+      LaunchResult result = launch(eager);
+      _exit(write(fds[1], &result, sizeof(result)) == sizeof(result) ? 0 : 1);
+    }
+    close(fds[1]);
+    LaunchResult result;
+    bool ok = child > 0 && read(fds[0], &result, sizeof(result)) == sizeof(result);
+    close(fds[0]);
+    waitpid(child, NULL, 0);
+    if (! ok) {
+      return false;
+    }
+    total->ns += result.ns;
+    total->counters.layer_inits += result.counters.layer_inits;
+    total->counters.text_measures += result.counters.text_measures;
+    total->counters.fonts_loaded += result.counters.fonts_loaded;
+    total->counters.bitmaps_loaded += result.counters.bitmaps_loaded;
+  }
+  return true;
+}
+
+static void report(const char* name, const LaunchResult* total) {
+  printf("%-34s %8.0f ns  %5.1f layers  %4.1f text measures  %4.1f fonts  %4.1f bitmaps\n", name,
+    total->ns / RUNS, (double)total->counters.layer_inits / RUNS, (double)total->counters.text_measures / RUNS,
+    (double)total->counters.fonts_loaded / RUNS, (double)total->counters.bitmaps_loaded / RUNS);
+}
+
+int main(int argc, char** argv) {
+  LaunchResult deferred;
+  LaunchResult eager;
+  if (! measure(false, &deferred) || ! measure(true, &eager)) {
+    fprintf(stderr, "A launch failed\n");
+    return 1;
+  }
+  report("launch, windows built on show", &deferred);
+  report("launch, windows built at launch", &eager);
+  return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <time.h>
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "status-parser.h"
+
+// Measures status_parser_parse on its own, for each response format the
+// server sends, as parses per second and bytes of response read per
+// second. Every response covers the full 13 line manifest.
+
+#define KEY_ORDER 0
+#define KEY_STATUSES 1
+#define KEY_SNAPSHOT 2
+#define KEY_UPDATE_TYPE 3
+#define KEY_MANIFEST 4
+
+#define MANIFEST_VERSION 7
+#define LINE_COUNT 13
+#define RESPONSE_SIZE 256
+#define RUNS 1000000
+
+typedef struct {
+  const char* name;
+  uint8_t buffer[RESPONSE_SIZE];
+  uint16_t size;
+  StatusParseResult expected;
+} Response;
+
+static const char* line_codes = "BLCECIDIDLHCJLMENOOVPIVIWC";
+
+static int find_line(const char* code) {
+  for (int l = 0; l < LINE_COUNT; l += 1) {
+    if (line_codes[l * 2] == code[0] && line_codes[l * 2 + 1] == code[1]) {
+      return l;
+    }
+  }
+  return -1;
+}
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void build_responses(Response* responses) {
+  uint8_t lines[LINE_COUNT];
+  uint8_t statuses[LINE_COUNT * 2];
+  char v2_statuses[LINE_COUNT * 3 + 1];
+  for (uint8_t l = 0; l < LINE_COUNT; l += 1) {
+    uint16_t status = l % 4 == 1 ? 0x002 : 0x001;
+    lines[l] = LINE_COUNT - 1 - l;
+    statuses[l * 2] = status & 0xFF;
+    statuses[l * 2 + 1] = status >> 8;
+    snprintf(v2_statuses + l * 3, 4, "%03d", status);
+  }
+  DictionaryIterator iter;
+
+  responses[0].name = "v2 strings";
+  dict_write_begin(&iter, responses[0].buffer, RESPONSE_SIZE);
+  dict_write_cstring(&iter, KEY_ORDER, line_codes);
+  dict_write_cstring(&iter, KEY_STATUSES, v2_statuses);
+  responses[0].size = dict_write_end(&iter);
+
+  responses[1].name = "v4 full";
+  dict_write_begin(&iter, responses[1].buffer, RESPONSE_SIZE);
+  dict_write_data(&iter, KEY_ORDER, lines, LINE_COUNT);
+  dict_write_data(&iter, KEY_STATUSES, statuses, LINE_COUNT * 2);
+  dict_write_uint32(&iter, KEY_SNAPSHOT, 1001);
+  dict_write_uint32(&iter, KEY_MANIFEST, MANIFEST_VERSION);
+  responses[1].size = dict_write_end(&iter);
+
+  responses[2].name = "v4 delta, 2 lines";
+  dict_write_begin(&iter, responses[2].buffer, RESPONSE_SIZE);
+  dict_write_data(&iter, KEY_ORDER, lines, 2);
+  dict_write_data(&iter, KEY_STATUSES, statuses, 4);
+  dict_write_uint32(&iter, KEY_SNAPSHOT, 1002);
+  dict_write_uint8(&iter, KEY_UPDATE_TYPE, STATUS_UPDATE_DELTA);
+  dict_write_uint32(&iter, KEY_MANIFEST, MANIFEST_VERSION);
+  responses[2].size = dict_write_end(&iter);
+
+  responses[3].name = "v4 unchanged";
+  dict_write_begin(&iter, responses[3].buffer, RESPONSE_SIZE);
+  dict_write_uint32(&iter, KEY_SNAPSHOT, 1002);
+  dict_write_uint8(&iter, KEY_UPDATE_TYPE, STATUS_UPDATE_UNCHANGED);
+  dict_write_uint32(&iter, KEY_MANIFEST, MANIFEST_VERSION);
+  responses[3].size = dict_write_end(&iter);
+
+  responses[4].name = "v4 bad length";
+  dict_write_begin(&iter, responses[4].buffer, RESPONSE_SIZE);
+  dict_write_data(&iter, KEY_ORDER, lines, LINE_COUNT);
+  dict_write_data(&iter, KEY_STATUSES, statuses, LINE_COUNT * 2 - 1);
+  dict_write_uint32(&iter, KEY_MANIFEST, MANIFEST_VERSION);
+  responses[4].size = dict_write_end(&iter);
+  responses[4].expected = STATUS_PARSE_BAD_LENGTH;
+}
+
+int main(int argc, char** argv) {
+  static Response responses[5];
+  build_responses(responses);
+
+  for (int r = 0; r < 5; r += 1) {
+    DictionaryIterator iter;
+    StatusSnapshot snapshot;
+    dict_read_begin_from_buffer(&iter, responses[r].buffer, responses[r].size);
+    if (status_parser_parse(&iter, MANIFEST_VERSION, LINE_COUNT, find_line, &snapshot) != responses[r].expected) {
+      fprintf(stderr, "%s: unexpected parse result\n", responses[r].name);
+      return 1;
+    }
+    volatile uint8_t count = 0;
+    double start = now_ns();
+    for (int run = 0; run < RUNS; run += 1) {
+      status_parser_parse(&iter, MANIFEST_VERSION, LINE_COUNT, find_line, &snapshot);
+      count += snapshot.count;
+    }
+    double elapsed_ns = now_ns() - start;
+    printf("%-20s %4d bytes %8.1f ns/parse %8.1f MB/s\n", responses[r].name, responses[r].size,
+      elapsed_ns / RUNS, (double)responses[r].size * RUNS / elapsed_ns * 1e3);
+  }
+  return 0;
+}
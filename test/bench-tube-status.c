@@ -0,0 +1,160 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+#include "line-manifest.h"
+#include "status-parser.h"
+#include "wnd-tube-status.h"
+
+// Times the tube status hot paths against the stub SDK: applying a status
+// response, asking for every row's height and drawing every row, as a
+// full scroll through the list would. Call counts are per frame.
+
+#define KEY_ORDER 0
+#define KEY_STATUSES 1
+#define KEY_SNAPSHOT 2
+#define KEY_MANIFEST 4
+
+#define RESPONSE_SIZE 256
+#define SUCCESS_RUNS 20000
+#define FRAME_RUNS 20000
+
+#define STATUS_GOOD_SERVICE 0x001
+#define STATUS_MINOR_DELAYS 0x002
+#define STATUS_SEVERE_DELAYS 0x010
+#define STATUS_PART_CLOSURE 0x020
+
+static uint8_t responses[2][RESPONSE_SIZE];
+static DictionaryIterator response_iters[2];
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Every line in manifest order, with a few of them disrupted. The second
+// response moves the disruptions so that applying it changes some rows.
+static void build_response(int r) {
+  uint8_t count = line_manifest_count();
+  uint8_t lines[MANIFEST_MAX_LINES];
+  uint8_t statuses[MANIFEST_MAX_LINES * 2];
+  for (uint8_t l = 0; l < count; l += 1) {
+    uint16_t status = STATUS_GOOD_SERVICE;
+    if ((l + r) % 4 == 1) {
+      status = STATUS_MINOR_DELAYS;
+    }
+    else if ((l + r) % 6 == 2) {
+      status = STATUS_SEVERE_DELAYS | STATUS_PART_CLOSURE;
+    }
+    lines[l] = l;
+    statuses[l * 2] = status & 0xFF;
+    statuses[l * 2 + 1] = status >> 8;
+  }
+  DictionaryIterator* iter = &response_iters[r];
+  dict_write_begin(iter, responses[r], RESPONSE_SIZE);
+  dict_write_data(iter, KEY_ORDER, lines, count);
+  dict_write_data(iter, KEY_STATUSES, statuses, count * 2);
+  dict_write_uint32(iter, KEY_SNAPSHOT, 1000 + r);
+  dict_write_uint32(iter, KEY_MANIFEST, line_manifest_version());
+  dict_write_end(iter);
+}
+
+static void report(const char* name, double total_ns, int runs) {
+  printf("%-28s %10.0f ns/call\n", name, total_ns / runs);
+}
+
+static void report_counts(const char* name, uint32_t count, int runs) {
+  printf("  %-26s %10.2f\n", name, (double)count / runs);
+}
+
+int main(int argc, char** argv) {
+  stub_start_app();
+  stub_cookie_deliver_all();
+  wnd_tube_status_show();
+  while (! stub_http_sent(NULL) && stub_timer_fire_next()) {
+  }
+  build_response(0);
+  build_response(1);
+  wnd_tube_http_success(HTTP_TUBE_STATUS, 200, &response_iters[0], NULL);
+
+  MenuLayer* menu = stub_top_menu_layer();
+  if (! menu) {
+    fprintf(stderr, "The tube status menu was never shown\n");
+    return 1;
+  }
+  printf("%d lines, %d px per full scroll\n\n", line_manifest_count(), stub_menu_draw_frame());
+
+  StatusSnapshot snapshot;
+  double start = now_ns();
+  for (int run = 0; run < SUCCESS_RUNS; run += 1) {
+    status_parser_parse(&response_iters[run % 2], line_manifest_version(), line_manifest_count(), line_manifest_find, &snapshot);
+  }
+  report("status_parser_parse", now_ns() - start, SUCCESS_RUNS);
+
+  stub_reset_counters();
+  start = now_ns();
+  for (int run = 0; run < SUCCESS_RUNS; run += 1) {
+    wnd_tube_http_success(HTTP_TUBE_STATUS, 200, &response_iters[run % 2], NULL);
+  }
+  report("wnd_tube_http_success", now_ns() - start, SUCCESS_RUNS);
+  report_counts("menu reloads", stub_counters.menu_reloads, SUCCESS_RUNS);
+  report_counts("redraws", stub_counters.layer_dirties, SUCCESS_RUNS);
+  report_counts("vibes", stub_counters.vibes, SUCCESS_RUNS);
+
+  uint16_t rows = menu->callbacks.get_num_rows(menu, 0, menu->callback_context);
+  MenuIndex index = { .section = 0 };
+  volatile int height = 0;
+  start = now_ns();
+  for (int run = 0; run < FRAME_RUNS; run += 1) {
+    for (index.row = 0; index.row < rows; index.row += 1) {
+      height += menu->callbacks.get_cell_height(menu, &index, menu->callback_context);
+    }
+  }
+  report("get_cell_height (all rows)", now_ns() - start, FRAME_RUNS);
+
+  start = now_ns();
+  for (int run = 0; run < FRAME_RUNS; run += 1) {
+    for (index.row = 0; index.row < rows; index.row += 1) {
+      menu->callbacks.draw_row(NULL, menu_layer_get_layer(menu), &index, menu->callback_context);
+    }
+  }
+  report("draw_row (all rows)", now_ns() - start, FRAME_RUNS);
+
+  stub_reset_counters();
+  start = now_ns();
+  for (int run = 0; run < FRAME_RUNS; run += 1) {
+    stub_menu_draw_frame();
+  }
+  report("full frame", now_ns() - start, FRAME_RUNS);
+  report_counts("cell height calls", stub_counters.cell_height_calls, FRAME_RUNS);
+  report_counts("row draws", stub_counters.row_draws, FRAME_RUNS);
+  report_counts("header draws", stub_counters.header_draws, FRAME_RUNS);
+  report_counts("text draws", stub_counters.text_draws, FRAME_RUNS);
+  report_counts("bitmap draws", stub_counters.bitmap_draws, FRAME_RUNS);
+  return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "status-parser.h"
+
+// Feeds arbitrary bytes to status_parser_parse as a received dictionary
+// and aborts if a parse that claims success breaks the snapshot's
+// invariants. The first byte picks the manifest's line count, the rest is
+// the dictionary. Build it with sanitizers so that reads past the message
+// are caught too; see "make fuzz" in the Makefile.
+//
+// Built with -DUSE_LIBFUZZER only LLVMFuzzerTestOneInput is defined, for
+// libFuzzer. Otherwise main runs each file named on the command line, as
+// AFL expects, or with no arguments mutates a few built in responses.
+
+#define KEY_ORDER 0
+#define KEY_STATUSES 1
+#define KEY_SNAPSHOT 2
+#define KEY_UPDATE_TYPE 3
+#define KEY_MANIFEST 4
+
+#define MANIFEST_VERSION 7
+#define SEED_SIZE 128
+#define NUM_SEEDS 5
+#define RANDOM_RUNS 200000
+
+static const char* line_codes = "BACEDIHCJUMENOPIVIWC";
+static uint8_t line_count = 0;
+
+// Like line_manifest_find, only lines within the manifest are found.
+static int find_line(const char* code) {
+  for (int l = 0; l < line_count && line_codes[l * 2]; l += 1) {
+    if (line_codes[l * 2] == code[0] && line_codes[l * 2 + 1] == code[1]) {
+      return l;
+    }
+  }
+  return -1;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  if (size < 1 || size > 0xFFFF) {
+    return 0;
+  }
+  line_count = data[0] % (MANIFEST_MAX_LINES + 1);
+  // An exact size copy, so that reading one byte too far is out of bounds.
+  uint8_t* message = malloc(size - 1);
+  memcpy(message, data + 1, size - 1);
+
+  DictionaryIterator iter;
+  StatusSnapshot snapshot;
+  dict_read_begin_from_buffer(&iter, message, size - 1);
+  StatusParseResult result = status_parser_parse(&iter, MANIFEST_VERSION, line_count, find_line, &snapshot);
+  if (result == STATUS_PARSE_MANIFEST_MISMATCH && snapshot.manifest_version == MANIFEST_VERSION) {
+    abort();
+  }
+  if (result == STATUS_PARSE_OK) {
+    if (snapshot.update_type > STATUS_UPDATE_DELTA || snapshot.count > MANIFEST_MAX_LINES) {
+      abort();
+    }
+    for (uint8_t p = 0; p < snapshot.count; p += 1) {
+      if (snapshot.lines[p] >= line_count) {
+        abort();
+      }
+    }
+  }
+  free(message);
+  return 0;
+}
+
+#ifndef USE_LIBFUZZER
+
+static uint8_t seeds[NUM_SEEDS][SEED_SIZE];
+static uint16_t seed_sizes[NUM_SEEDS];
+
+// Each seed starts with the line count byte the harness expects.
+static void build_seeds() {
+  static const uint8_t lines[] = { 0, 3, 7, 9 };
+  static const uint8_t statuses[] = { 1, 0, 2, 0, 0x30, 0, 0, 2 };
+  DictionaryIterator iter;
+
+  dict_write_begin(&iter, seeds[0] + 1, SEED_SIZE - 1);
+  dict_write_cstring(&iter, KEY_ORDER, "BACEDIJU");
+  dict_write_cstring(&iter, KEY_STATUSES, "001002048512");
+  seed_sizes[0] = dict_write_end(&iter);
+
+  dict_write_begin(&iter, seeds[1] + 1, SEED_SIZE - 1);
+  dict_write_data(&iter, KEY_ORDER, lines, sizeof(lines));
+  dict_write_data(&iter, KEY_STATUSES, statuses, sizeof(statuses));
+  dict_write_uint32(&iter, KEY_SNAPSHOT, 1001);
+  dict_write_uint32(&iter, KEY_MANIFEST, MANIFEST_VERSION);
+  seed_sizes[1] = dict_write_end(&iter);
+
+  dict_write_begin(&iter, seeds[2] + 1, SEED_SIZE - 1);
+  dict_write_data(&iter, KEY_ORDER, lines, 2);
+  dict_write_data(&iter, KEY_STATUSES, statuses, 4);
+  dict_write_uint32(&iter, KEY_SNAPSHOT, 1002);
+  dict_write_uint8(&iter, KEY_UPDATE_TYPE, STATUS_UPDATE_DELTA);
+  dict_write_uint32(&iter, KEY_MANIFEST, MANIFEST_VERSION);
+  seed_sizes[2] = dict_write_end(&iter);
+
+  dict_write_begin(&iter, seeds[3] + 1, SEED_SIZE - 1);
+  dict_write_uint32(&iter, KEY_SNAPSHOT, 1002);
+  dict_write_uint8(&iter, KEY_UPDATE_TYPE, STATUS_UPDATE_UNCHANGED);
+  seed_sizes[3] = dict_write_end(&iter);
+
+  dict_write_begin(&iter, seeds[4] + 1, SEED_SIZE - 1);
+  dict_write_uint32(&iter, KEY_MANIFEST, MANIFEST_VERSION + 1);
+  seed_sizes[4] = dict_write_end(&iter);
+
+  for (int s = 0; s < NUM_SEEDS; s += 1) {
+    seeds[s][0] = 10;
+    seed_sizes[s] += 1;
+  }
+}
+
+// Flips, overwrites, inserts or cuts a few bytes of a seed. Tuple headers
+// are small, so most mutations land on a type, length or key.
+static size_t mutate(uint8_t* data, size_t size, size_t capacity) {
+  int mutations = 1 + rand() % 4;
+  for (int m = 0; m < mutations && size > 0; m += 1) {
+    size_t at = rand() % size;
+    switch (rand() % 5) {
+      case 0:
+        data[at] ^= 1 << (rand() % 8);
+      break;
+      case 1:
+        data[at] = rand();
+      break;
+      case 2:
+        data[at] = (rand() % 2) ? 0 : 0xFF;
+      break;
+      case 3:
+        if (size < capacity) {
+          memmove(data + at + 1, data + at, size - at);
+          data[at] = rand();
+          size += 1;
+        }
+      break;
+      case 4:
+        size = at + 1;
+      break;
+    }
+  }
+  return size;
+}
+
+static int run_file(const char* path) {
+  static uint8_t data[0x10000];
+  FILE* file = fopen(path, "rb");
+  if (! file) {
+    perror(path);
+    return 1;
+  }
+  size_t size = fread(data, 1, sizeof(data), file);
+  fclose(file);
+  LLVMFuzzerTestOneInput(data, size);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    int failures = 0;
+    for (int a = 1; a < argc; a += 1) {
+      failures += run_file(argv[a]);
+    }
+    return failures == 0 ? 0 : 1;
+  }
+
+  build_seeds();
+  srand(1);
+  uint8_t data[SEED_SIZE * 2];
+  for (int run = 0; run < RANDOM_RUNS; run += 1) {
+    int seed = run % NUM_SEEDS;
+    memcpy(data, seeds[seed], seed_sizes[seed]);
+    LLVMFuzzerTestOneInput(data, mutate(data, seed_sizes[seed], sizeof(data)));
+  }
+  printf("%d mutated responses parsed\n", RANDOM_RUNS);
+  return 0;
+}
+
+#endif // USE_LIBFUZZER
@@ -0,0 +1,104 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+#include "request-scheduler.h"
+#include "line-manifest.h"
+#include "wnd-tube-status.h"
+#include "wnd-line-detail.h"
+
+// Runs the tube status request flow end to end against tools/fake-api.py
+// through the stub's loopback and times it: the first load, including
+// the manifest fetch, a few refreshes after it and a line detail fetch.
+// Simulated timers are fired as soon as nothing is left to deliver, so
+// the times are the real round trips plus the app's own work. Fails if a
+// request couldn't reach the server or a reply wouldn't fit.
+//
+//   loopback-refresh HOST PORT [SCENARIO]
+
+#define REFRESHES 3
+#define MAX_STEPS 500
+
+static const int32_t flow_requests[] = {
+  HTTP_TUBE_STATUS,
+  HTTP_LINE_MANIFEST,
+  HTTP_LINE_DETAIL
+};
+
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static bool flow_busy() {
+  for (unsigned r = 0; r < sizeof(flow_requests) / sizeof(int32_t); r += 1) {
+    RequestState state = request_scheduler_state(flow_requests[r]);
+    if (state == REQUEST_QUEUED || state == REQUEST_IN_FLIGHT || state == REQUEST_RETRY_WAIT) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Delivers requests and fires the timers they wait on until the flow has
+// nothing left in progress.
+static void run_flow(const char* name, const char* scenario) {
+  uint32_t sends = stub_counters.http_sends;
+  double start = now_ms();
+  for (int step = 0; step < MAX_STEPS; step += 1) {
+    if (! stub_loopback_deliver() && ! (flow_busy() && stub_timer_fire_next())) {
+      break;
+    }
+  }
+  printf("%-10s %-14s %8.2f ms %3u requests  %s\n", scenario, name, now_ms() - start,
+    stub_counters.http_sends - sends, wnd_tube_status_digest());
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s HOST PORT [SCENARIO]\n", argv[0]);
+    return 2;
+  }
+  const char* scenario = argc > 3 ? argv[3] : "";
+  if (! stub_loopback_start(argv[1], atoi(argv[2]))) {
+    fprintf(stderr, "Nothing is listening on %s:%s\n", argv[1], argv[2]);
+    return 1;
+  }
+  stub_start_app();
+  stub_cookie_deliver_all();
+
+  wnd_tube_status_show();
+  run_flow("first load", scenario);
+  for (int refresh = 0; refresh < REFRESHES; refresh += 1) {
+    wnd_tube_status_refresh_timer();
+    run_flow("refresh", scenario);
+  }
+  wnd_line_detail_show(line_manifest_code(1), line_manifest_name(1), 2);
+  run_flow("line detail", scenario);
+  return stub_loopback_errors() == 0 ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef HTTP_H
+#define HTTP_H
+
+// The parts of httpebble's http.h the app uses. Requests and cookie
+// messages are answered by the test through the functions in stub.h.
+
+#define HTTP_UUID { 0x91, 0x41, 0xB6, 0x28, 0xBC, 0x89, 0x49, 0x8E, 0xB1, 0x47, 0xC8, 0x84, 0xF0, 0x16, 0x02, 0x15 }
+
+typedef enum {
+  HTTP_OK = 0,
+  HTTP_SEND_TIMEOUT = 2,
+  HTTP_SEND_REJECTED = 4,
+  HTTP_NOT_CONNECTED = 8,
+  HTTP_BRIDGE_NOT_RUNNING = 16,
+  HTTP_INVALID_ARGS = 32,
+  HTTP_BUSY = 64,
+  HTTP_BUFFER_OVERFLOW = 128,
+  HTTP_ALREADY_RELEASED = 256,
+  HTTP_CALLBACK_ALREADY_REGISTERED = 512,
+  HTTP_CALLBACK_NOT_REGISTERED = 1024,
+  HTTP_NOT_ENOUGH_STORAGE = 2048,
+  HTTP_INVALID_DICT_ARGS = 4096,
+  HTTP_INTERNAL_INCONSISTENCY = 8192,
+  HTTP_INVALID_BRIDGE_RESPONSE = 16384
+} HTTPResult;
+
+typedef void (*HTTPRequestFailedHandler)(int32_t cookie, int http_status, void* context);
+typedef void (*HTTPRequestSucceededHandler)(int32_t cookie, int http_status, DictionaryIterator* received, void* context);
+typedef void (*HTTPPhoneReconnectedHandler)(void* context);
+typedef void (*HTTPCookieGetCallback)(int32_t request_id, Tuple* result, void* context);
+typedef void (*HTTPCookieSetCallback)(int32_t request_id, bool successful, void* context);
+
+typedef struct {
+  HTTPRequestFailedHandler failure;
+  HTTPRequestSucceededHandler success;
+  HTTPPhoneReconnectedHandler reconnect;
+  HTTPCookieGetCallback cookie_get;
+  HTTPCookieSetCallback cookie_set;
+} HTTPCallbacks;
+
+bool http_register_callbacks(HTTPCallbacks callbacks, void* context);
+void http_set_app_id(int32_t new_app_id);
+HTTPResult http_out_get(const char* url, int32_t cookie, DictionaryIterator** iter);
+HTTPResult http_out_send();
+HTTPResult http_cookie_get(int32_t request_id, uint32_t key);
+HTTPResult http_cookie_set_start(int32_t request_id, DictionaryIterator** iter);
+HTTPResult http_cookie_set_end();
+
+#endif // HTTP_H
@@ -0,0 +1,355 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+
+// Posts the app's requests to tools/fake-api.py over a real socket and
+// feeds the replies back, so whole request flows can be run and timed
+// against the fake server. A request goes out as a JSON object the way
+// httpebble posts it, with byte arrays as ["d", base64]. In the reply,
+// numbers, strings and ["d", base64] become int32, cstring and byte array
+// tuples, written into a buffer the size of the app's inbound one.
+
+#define JSON_SIZE 2048
+#define RESPONSE_SIZE 4096
+#define INBOUND_SIZE 256
+#define CONNECT_ATTEMPTS 40
+#define CONNECT_WAIT_US 50000
+
+static int post(const char* path, const char* json, char* response, int size, const char** body);
+static int connect_to_server();
+static bool write_json(const StubRequest* request, char* json, int size);
+static bool read_json(const char* json, DictionaryIterator* iter);
+static const char* skip_space(const char* cursor);
+static const char* read_string(const char* cursor, char* out, int size);
+static int base64_encode(const uint8_t* data, int length, char* out, int size);
+static int base64_decode(const char* text, uint8_t* out, int size);
+
+static const char* base64_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static char server_host[64];
+static int server_port = 0;
+static uint32_t loopback_errors = 0;
+
+/**
+ TEST CONTROL
+ **/
+
+// Waits for the server to accept connections, so that its start up isn't
+// timed with the first request. Returns false if it never does.
+bool stub_loopback_start(const char* host, int port) {
+  strncpy(server_host, host, sizeof(server_host) - 1);
+  server_port = port;
+  int sock = connect_to_server();
+  if (sock < 0) {
+    return false;
+  }
+  close(sock);
+  return true;
+}
+
+// Sends the request the app sent since the last call, if there was one,
+// and delivers the reply. A server that can't be reached, or a reply that
+// wouldn't fit in the app's inbound buffer, fails the request and counts
+// as a loopback error.
+bool stub_loopback_deliver() {
+  StubRequest request;
+  if (! stub_http_sent(&request)) {
+    return false;
+  }
+  const char* path = strstr(request.url, "://");
+  path = path ? strchr(path + 3, '/') : NULL;
+  char json[JSON_SIZE];
+  static char response[RESPONSE_SIZE];
+  const char* body;
+  int status = -1;
+  if (path && write_json(&request, json, sizeof(json))) {
+    status = post(path, json, response, sizeof(response), &body);
+  }
+  if (status < 0) {
+    fprintf(stderr, "loopback: no reply for %s\n", request.url);
+    loopback_errors += 1;
+    stub_http_fail(request.cookie, HTTP_SEND_TIMEOUT);
+    return true;
+  }
+  if (status != 200) {
+    stub_http_fail(request.cookie, status);
+    return true;
+  }
+  uint8_t buffer[INBOUND_SIZE];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  if (! read_json(body, &iter)) {
+    fprintf(stderr, "loopback: reply for %s doesn't fit in %d bytes: %s\n", request.url, INBOUND_SIZE, body);
+    loopback_errors += 1;
+    stub_http_fail(request.cookie, HTTP_BUFFER_OVERFLOW);
+    return true;
+  }
+  dict_write_end(&iter);
+  stub_http_reply(request.cookie, status, &iter);
+  return true;
+}
+
+uint32_t stub_loopback_errors() {
+  return loopback_errors;
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+// Returns the HTTP status, or -1 if there was no usable reply. The fake
+// server closes the connection after each reply.
+int post(const char* path, const char* json, char* response, int size, const char** body) {
+  int sock = connect_to_server();
+  if (sock < 0) {
+    return -1;
+  }
+  char header[256];
+  int header_length = snprintf(header, sizeof(header),
+    "POST %s HTTP/1.0\r\nHost: %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\n\r\n",
+    path, server_host, (int)strlen(json));
+  if (write(sock, header, header_length) != header_length || write(sock, json, strlen(json)) != (ssize_t)strlen(json)) {
+    close(sock);
+    return -1;
+  }
+  int length = 0;
+  ssize_t got;
+  while (length < size - 1 && (got = read(sock, response + length, size - 1 - length)) > 0) {
+    length += got;
+  }
+  close(sock);
+  response[length] = '\0';
+  int status;
+  char* end = strstr(response, "\r\n\r\n");
+  if (! end || sscanf(response, "HTTP/%*s %d", &status) != 1) {
+    return -1;
+  }
+  *body = end + 4;
+  return status;
+}
+
+// The server may still be starting, so connecting is retried for a while.
+int connect_to_server() {
+  struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+  struct addrinfo* address;
+  char port[8];
+  snprintf(port, sizeof(port), "%d", server_port);
+  if (getaddrinfo(server_host, port, &hints, &address) != 0) {
+    return -1;
+  }
+  int sock = -1;
+  for (int attempt = 0; attempt < CONNECT_ATTEMPTS && sock < 0; attempt += 1) {
+    sock = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (sock >= 0 && connect(sock, address->ai_addr, address->ai_addrlen) != 0) {
+      close(sock);
+      sock = -1;
+      usleep(CONNECT_WAIT_US);
+    }
+  }
+  freeaddrinfo(address);
+  return sock;
+}
+
+bool write_json(const StubRequest* request, char* json, int size) {
+  int length = snprintf(json, size, "{");
+  DictionaryIterator iter;
+  Tuple* tuple = dict_read_begin_from_buffer(&iter, request->body, request->body_size);
+  while (tuple && length < size) {
+    length += snprintf(json + length, size - length, "%s\"%lu\": ", length > 1 ? ", " : "", (unsigned long)tuple->key);
+    if (length >= size) {
+      return false;
+    }
+    switch (tuple->type) {
+      case TUPLE_CSTRING:
+        length += snprintf(json + length, size - length, "\"%s\"", tuple->value->cstring);
+      break;
+      case TUPLE_BYTE_ARRAY: {
+        char encoded[512];
+        if (base64_encode(tuple->value->data, tuple->length, encoded, sizeof(encoded)) < 0) {
+          return false;
+        }
+        length += snprintf(json + length, size - length, "[\"d\", \"%s\"]", encoded);
+      }
+      break;
+      case TUPLE_UINT:
+        length += snprintf(json + length, size - length, "%lu", (unsigned long)(tuple->length == 1 ? tuple->value->uint8 :
+          tuple->length == 2 ? tuple->value->uint16 : tuple->value->uint32));
+      break;
+      case TUPLE_INT:
+        length += snprintf(json + length, size - length, "%ld", (long)(tuple->length == 1 ? tuple->value->int8 :
+          tuple->length == 2 ? tuple->value->int16 : tuple->value->int32));
+      break;
+    }
+    tuple = dict_read_next(&iter);
+  }
+  length += snprintf(json + length, size - length, "}");
+  return length < size;
+}
+
+// Only the flat objects the fake server sends are understood.
+bool read_json(const char* json, DictionaryIterator* iter) {
+  char key[16];
+  char text[512];
+  const char* cursor = skip_space(json);
+  if (*cursor != '{') {
+    return false;
+  }
+  cursor = skip_space(cursor + 1);
+  while (*cursor && *cursor != '}') {
+    cursor = read_string(cursor, key, sizeof(key));
+    if (! cursor || *(cursor = skip_space(cursor)) != ':') {
+      return false;
+    }
+    cursor = skip_space(cursor + 1);
+    uint32_t tuple_key = strtoul(key, NULL, 10);
+    DictionaryResult result;
+    if (*cursor == '"') {
+      if (! (cursor = read_string(cursor, text, sizeof(text)))) {
+        return false;
+      }
+      result = dict_write_cstring(iter, tuple_key, text);
+    }
+    else if (*cursor == '[') {
+      cursor = read_string(skip_space(cursor + 1), text, sizeof(text));
+      if (! cursor || strcmp(text, "d") != 0 || *(cursor = skip_space(cursor)) != ',') {
+        return false;
+      }
+      if (! (cursor = read_string(skip_space(cursor + 1), text, sizeof(text))) || *(cursor = skip_space(cursor)) != ']') {
+        return false;
+      }
+      cursor += 1;
+      uint8_t data[384];
+      int length = base64_decode(text, data, sizeof(data));
+      if (length < 0) {
+        return false;
+      }
+      result = dict_write_data(iter, tuple_key, data, length);
+    }
+    else {
+      char* end;
+      long value = strtol(cursor, &end, 10);
+      if (end == cursor) {
+        return false;
+      }
+      cursor = end;
+      result = dict_write_int32(iter, tuple_key, value);
+    }
+    if (result != DICT_OK) {
+      return false;
+    }
+    cursor = skip_space(cursor);
+    if (*cursor == ',') {
+      cursor = skip_space(cursor + 1);
+    }
+  }
+  return *cursor == '}';
+}
+
+const char* skip_space(const char* cursor) {
+  while (*cursor == ' ' || *cursor == '\n' || *cursor == '\r' || *cursor == '\t') {
+    cursor += 1;
+  }
+  return cursor;
+}
+
+// Reads a quoted string. Escapes are limited to what json.dumps writes
+// for ASCII text.
+const char* read_string(const char* cursor, char* out, int size) {
+  if (*cursor != '"') {
+    return NULL;
+  }
+  cursor += 1;
+  int length = 0;
+  while (*cursor && *cursor != '"') {
+    char c = *cursor;
+    if (c == '\\') {
+      cursor += 1;
+      switch (*cursor) {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'u':
+          c = (char)strtol((char[]){ cursor[1], cursor[2], cursor[3], cursor[4], '\0' }, NULL, 16);
+          cursor += 4;
+        break;
+        default: c = *cursor; break;
+      }
+    }
+    if (length >= size - 1) {
+      return NULL;
+    }
+    out[length] = c;
+    length += 1;
+    cursor += 1;
+  }
+  out[length] = '\0';
+  return *cursor == '"' ? cursor + 1 : NULL;
+}
+
+int base64_encode(const uint8_t* data, int length, char* out, int size) {
+  int written = 0;
+  for (int i = 0; i < length; i += 3) {
+    if (written + 4 >= size) {
+      return -1;
+    }
+    uint32_t block = data[i] << 16 | (i + 1 < length ? data[i + 1] << 8 : 0) | (i + 2 < length ? data[i + 2] : 0);
+    out[written] = base64_chars[(block >> 18) & 63];
+    out[written + 1] = base64_chars[(block >> 12) & 63];
+    out[written + 2] = i + 1 < length ? base64_chars[(block >> 6) & 63] : '=';
+    out[written + 3] = i + 2 < length ? base64_chars[block & 63] : '=';
+    written += 4;
+  }
+  out[written] = '\0';
+  return written;
+}
+
+int base64_decode(const char* text, uint8_t* out, int size) {
+  int length = 0;
+  uint32_t block = 0;
+  int bits = 0;
+  for (; *text && *text != '='; text += 1) {
+    const char* position = strchr(base64_chars, *text);
+    if (! position) {
+      return -1;
+    }
+    block = (block << 6) | (position - base64_chars);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      if (length >= size) {
+        return -1;
+      }
+      out[length] = (block >> bits) & 0xFF;
+      length += 1;
+    }
+  }
+  return length;
+}
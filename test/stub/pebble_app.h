@@ -0,0 +1,63 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PEBBLE_APP_H
+#define PEBBLE_APP_H
+
+#include "pebble_os.h"
+
+typedef void (*PebbleAppInitEventHandler)(AppContextRef app_ctx);
+typedef void (*PebbleAppDeinitEventHandler)(AppContextRef app_ctx);
+typedef void (*PebbleAppTimerHandler)(AppContextRef app_ctx, AppTimerHandle handle, uint32_t cookie);
+
+typedef struct {
+  uint16_t inbound;
+  uint16_t outbound;
+} PebbleAppMessagingBufferSizes;
+
+typedef struct {
+  PebbleAppMessagingBufferSizes buffer_sizes;
+} PebbleAppMessagingInfo;
+
+typedef struct {
+  PebbleAppInitEventHandler init_handler;
+  PebbleAppDeinitEventHandler deinit_handler;
+  PebbleAppTimerHandler timer_handler;
+  PebbleAppMessagingInfo messaging_info;
+} PebbleAppHandlers;
+
+typedef struct {
+  uint32_t version;
+} ResBankVersion;
+
+// The resource ids are generated from resource_map.json by the Makefile.
+#include "resource_ids.auto.h"
+
+extern ResBankVersion APP_RESOURCES;
+
+#define APP_INFO_STANDARD_APP 0
+#define PBL_APP_INFO(...)
+
+void app_event_loop(AppContextRef app_task_ctx, PebbleAppHandlers* handlers);
+void resource_init_current_app(ResBankVersion* version);
+
+#endif // PEBBLE_APP_H
@@ -0,0 +1,266 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PEBBLE_OS_H
+#define PEBBLE_OS_H
+
+// Just enough of the Pebble SDK 1.x API to build the app on Linux. The
+// types keep the SDK's names and fields that the app touches; anything
+// else a stub needs to remember is added at the end of the struct.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct { int16_t x, y; } GPoint;
+typedef struct { int16_t w, h; } GSize;
+typedef struct { GPoint origin; GSize size; } GRect;
+#define GPoint(x, y) ((GPoint){ (x), (y) })
+#define GPointZero GPoint(0, 0)
+#define GSize(w, h) ((GSize){ (w), (h) })
+#define GRect(x, y, w, h) ((GRect){ { (x), (y) }, { (w), (h) } })
+
+typedef enum { GColorClear = -1, GColorBlack = 0, GColorWhite = 1 } GColor;
+typedef enum { GTextAlignmentLeft, GTextAlignmentCenter, GTextAlignmentRight } GTextAlignment;
+typedef enum { GTextOverflowModeWordWrap, GTextOverflowModeTrailingEllipsis, GTextOverflowModeFill } GTextOverflowMode;
+
+typedef struct GContext GContext;
+typedef void* GFont;
+typedef struct GTextLayoutCache* GTextLayoutCacheRef;
+typedef struct ResHandleStub* ResHandle;
+typedef void* AppContextRef;
+typedef uint32_t AppTimerHandle;
+
+typedef struct {
+  void* addr;
+  uint16_t row_size_bytes;
+  uint16_t info_flags;
+  GRect bounds;
+} GBitmap;
+
+typedef struct {
+  GBitmap bmp;
+  uint8_t* data;
+} HeapBitmap;
+
+typedef struct Layer {
+  GRect bounds;
+  GRect frame;
+  struct Layer* parent;
+} Layer;
+
+struct Window;
+typedef void (*WindowHandler)(struct Window* window);
+
+typedef struct {
+  WindowHandler load;
+  WindowHandler appear;
+  WindowHandler disappear;
+  WindowHandler unload;
+} WindowHandlers;
+
+typedef struct Window {
+  Layer layer;
+  const char* debug_name;
+  WindowHandlers window_handlers;
+  bool is_loaded;
+} Window;
+
+typedef struct {
+  Layer layer;
+  const char* text;
+  GFont font;
+} TextLayer;
+
+typedef struct {
+  Layer layer;
+  GSize content_size;
+  GPoint content_offset;
+} ScrollLayer;
+
+typedef struct {
+  uint16_t section;
+  uint16_t row;
+} MenuIndex;
+
+typedef enum { MenuRowAlignNone, MenuRowAlignCenter, MenuRowAlignTop, MenuRowAlignBottom } MenuRowAlign;
+
+#define MENU_CELL_BASIC_HEADER_HEIGHT 16
+
+struct MenuLayer;
+typedef uint16_t (*MenuLayerGetNumberOfSectionsCallback)(struct MenuLayer* menu_layer, void* callback_context);
+typedef uint16_t (*MenuLayerGetNumberOfRowsInSectionsCallback)(struct MenuLayer* menu_layer, uint16_t section_index, void* callback_context);
+typedef int16_t (*MenuLayerGetCellHeightCallback)(struct MenuLayer* menu_layer, MenuIndex* cell_index, void* callback_context);
+typedef int16_t (*MenuLayerGetHeaderHeightCallback)(struct MenuLayer* menu_layer, uint16_t section_index, void* callback_context);
+typedef void (*MenuLayerDrawRowCallback)(GContext* ctx, const Layer* cell_layer, MenuIndex* cell_index, void* callback_context);
+typedef void (*MenuLayerDrawHeaderCallback)(GContext* ctx, const Layer* cell_layer, uint16_t section_index, void* callback_context);
+typedef void (*MenuLayerSelectCallback)(struct MenuLayer* menu_layer, MenuIndex* cell_index, void* callback_context);
+
+typedef struct {
+  MenuLayerGetNumberOfSectionsCallback get_num_sections;
+  MenuLayerGetNumberOfRowsInSectionsCallback get_num_rows;
+  MenuLayerGetCellHeightCallback get_cell_height;
+  MenuLayerGetHeaderHeightCallback get_header_height;
+  MenuLayerDrawRowCallback draw_row;
+  MenuLayerDrawHeaderCallback draw_header;
+  MenuLayerSelectCallback select_click;
+  MenuLayerSelectCallback select_long_click;
+} MenuLayerCallbacks;
+
+typedef struct MenuLayer {
+  ScrollLayer scroll_layer;
+  MenuLayerCallbacks callbacks;
+  void* callback_context;
+  MenuIndex selection;
+} MenuLayer;
+
+typedef struct {
+  int tm_sec;
+  int tm_min;
+  int tm_hour;
+  int tm_mday;
+  int tm_mon;
+  int tm_year;
+  int tm_wday;
+  int tm_yday;
+  int tm_isdst;
+} PblTm;
+
+typedef struct {
+  const uint32_t* durations;
+  uint32_t num_segments;
+} VibePattern;
+
+typedef enum {
+  TUPLE_BYTE_ARRAY = 0,
+  TUPLE_CSTRING = 1,
+  TUPLE_UINT = 2,
+  TUPLE_INT = 3
+} TupleType;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t key;
+  TupleType type:8;
+  uint16_t length;
+  union {
+    uint8_t data[0];
+    char cstring[0];
+    uint8_t uint8;
+    uint16_t uint16;
+    uint32_t uint32;
+    int8_t int8;
+    int16_t int16;
+    int32_t int32;
+  } value[];
+} Tuple;
+
+typedef struct __attribute__((__packed__)) {
+  uint8_t count;
+  Tuple head[];
+} Dictionary;
+
+typedef struct {
+  Dictionary* dictionary;
+  const void* end;
+  Tuple* cursor;
+} DictionaryIterator;
+
+typedef enum {
+  DICT_OK = 0,
+  DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+  DICT_INVALID_ARGS = 1 << 2
+} DictionaryResult;
+
+Tuple* dict_find(const DictionaryIterator* iter, const uint32_t key);
+Tuple* dict_read_first(DictionaryIterator* iter);
+Tuple* dict_read_next(DictionaryIterator* iter);
+Tuple* dict_read_begin_from_buffer(DictionaryIterator* iter, const uint8_t* const buffer, const uint16_t size);
+DictionaryResult dict_write_begin(DictionaryIterator* iter, uint8_t* const buffer, const uint16_t size);
+DictionaryResult dict_write_data(DictionaryIterator* iter, const uint32_t key, const uint8_t* const data, const uint16_t size);
+DictionaryResult dict_write_cstring(DictionaryIterator* iter, const uint32_t key, const char* const cstring);
+DictionaryResult dict_write_int(DictionaryIterator* iter, const uint32_t key, const void* integer, const uint8_t width_bytes, const bool is_signed);
+DictionaryResult dict_write_uint8(DictionaryIterator* iter, const uint32_t key, const uint8_t value);
+DictionaryResult dict_write_uint16(DictionaryIterator* iter, const uint32_t key, const uint16_t value);
+DictionaryResult dict_write_uint32(DictionaryIterator* iter, const uint32_t key, const uint32_t value);
+DictionaryResult dict_write_int8(DictionaryIterator* iter, const uint32_t key, const int8_t value);
+DictionaryResult dict_write_int16(DictionaryIterator* iter, const uint32_t key, const int16_t value);
+DictionaryResult dict_write_int32(DictionaryIterator* iter, const uint32_t key, const int32_t value);
+uint32_t dict_write_end(DictionaryIterator* iter);
+
+void window_init(Window* window, const char* debug_name);
+void window_set_window_handlers(Window* window, WindowHandlers handlers);
+void window_stack_push(Window* window, bool animated);
+Window* window_stack_pop(bool animated);
+Window* window_stack_get_top_window(void);
+void layer_add_child(Layer* parent, Layer* child);
+void layer_mark_dirty(Layer* layer);
+
+void menu_layer_init(MenuLayer* menu_layer, GRect frame);
+void menu_layer_set_callbacks(MenuLayer* menu_layer, void* callback_context, MenuLayerCallbacks callbacks);
+void menu_layer_set_click_config_onto_window(MenuLayer* menu_layer, Window* window);
+Layer* menu_layer_get_layer(MenuLayer* menu_layer);
+void menu_layer_reload_data(MenuLayer* menu_layer);
+void menu_cell_basic_header_draw(GContext* ctx, const Layer* cell_layer, const char* title);
+
+void scroll_layer_init(ScrollLayer* scroll_layer, GRect frame);
+void scroll_layer_set_click_config_onto_window(ScrollLayer* scroll_layer, Window* window);
+void scroll_layer_add_child(ScrollLayer* scroll_layer, Layer* child);
+void scroll_layer_set_content_size(ScrollLayer* scroll_layer, GSize size);
+void scroll_layer_set_content_offset(ScrollLayer* scroll_layer, GPoint offset, bool animated);
+
+void text_layer_init(TextLayer* text_layer, GRect frame);
+void text_layer_set_text(TextLayer* text_layer, const char* text);
+void text_layer_set_font(TextLayer* text_layer, GFont font);
+void text_layer_set_text_color(TextLayer* text_layer, GColor color);
+void text_layer_set_background_color(TextLayer* text_layer, GColor color);
+void text_layer_set_text_alignment(TextLayer* text_layer, GTextAlignment alignment);
+void text_layer_set_overflow_mode(TextLayer* text_layer, GTextOverflowMode overflow_mode);
+void text_layer_set_size(TextLayer* text_layer, const GSize max_size);
+GSize text_layer_get_max_used_size(GContext* ctx, TextLayer* text_layer);
+
+GContext* app_get_current_graphics_context(void);
+void graphics_context_set_text_color(GContext* ctx, GColor color);
+void graphics_context_set_fill_color(GContext* ctx, GColor color);
+void graphics_fill_circle(GContext* ctx, GPoint p, uint16_t radius);
+void graphics_draw_bitmap_in_rect(GContext* ctx, const GBitmap* bitmap, GRect rect);
+void graphics_text_draw(GContext* ctx, const char* text, const GFont font, const GRect box, const GTextOverflowMode overflow_mode, const GTextAlignment alignment, const GTextLayoutCacheRef layout);
+bool gbitmap_init_as_sub_bitmap(GBitmap* sub_bitmap, const GBitmap* base_bitmap, GRect sub_rect);
+bool heap_bitmap_init(HeapBitmap* image, int resource_id);
+void heap_bitmap_deinit(HeapBitmap* image);
+
+ResHandle resource_get_handle(uint32_t file_id);
+GFont fonts_get_system_font(const char* font_key);
+GFont fonts_load_custom_font(ResHandle resource);
+void fonts_unload_custom_font(GFont font);
+
+AppTimerHandle app_timer_send_event(AppContextRef app_ctx, uint32_t timeout_ms, uint32_t cookie);
+bool app_timer_cancel_event(AppContextRef app_ctx_ref, AppTimerHandle handle);
+
+void get_time(PblTm* time);
+void string_format_time(char* ptr, size_t maxsize, const char* format, const PblTm* timeptr);
+bool clock_is_24h_style(void);
+
+void vibes_enqueue_custom_pattern(VibePattern pattern);
+
+#endif // PEBBLE_OS_H
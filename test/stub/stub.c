@@ -0,0 +1,850 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "pebble_fonts.h"
+#include "http.h"
+#include "rockshot.h"
+#include "stub.h"
+
+#define TUPLE_HEADER_SIZE (sizeof(Tuple))
+#define MAX_WINDOWS 8
+#define MAX_MENUS 8
+#define MAX_TIMERS 16
+#define MAX_COOKIES 16
+#define RESTART_COOKIES_ENV "STUB_RESTART_COOKIES"
+#define COOKIE_SIZE 256
+#define MAX_TEXT_LOG 64
+
+typedef struct {
+  AppTimerHandle handle;
+  uint32_t due;
+  uint32_t cookie;
+} StubTimer;
+
+typedef struct {
+  bool used;
+  uint32_t key;
+  uint16_t length;
+  uint8_t data[COOKIE_SIZE];
+} StubCookie;
+
+typedef struct {
+  int32_t request_id;
+  uint32_t key;
+  bool is_set;
+  bool successful;
+} StubCookieMessage;
+
+void pbl_main(void* params);
+
+static Tuple* write_tuple(DictionaryIterator* iter, uint32_t key, TupleType type, const void* data, uint16_t length);
+static bool tuple_fits(const DictionaryIterator* iter, const Tuple* tuple);
+static void draw_menu_section(MenuLayer* menu, uint16_t section, int* height);
+
+StubCounters stub_counters;
+ResBankVersion APP_RESOURCES;
+
+static PebbleAppHandlers app_handlers;
+static HTTPCallbacks http_callbacks;
+static void* http_context = NULL;
+static bool connected = true;
+
+static StubRequest last_request;
+static DictionaryIterator request_iter;
+static bool request_open = false;
+static bool request_sent = false;
+
+static StubCookie cookies[MAX_COOKIES];
+static StubCookieMessage cookie_message;
+static bool cookie_message_pending = false;
+static const char* text_log[MAX_TEXT_LOG];
+static uint16_t text_log_count = 0;
+static uint8_t cookie_buffer[COOKIE_SIZE];
+static DictionaryIterator cookie_iter;
+
+static StubTimer timers[MAX_TIMERS];
+static AppTimerHandle next_timer_handle = 1;
+static uint32_t now_ms = 0;
+static PblTm now_tm = { .tm_hour = 9, .tm_min = 0, .tm_yday = 100 };
+
+static Window* window_stack[MAX_WINDOWS];
+static uint8_t window_count = 0;
+static MenuLayer* menus[MAX_MENUS];
+static uint8_t menu_count = 0;
+
+static struct { int id; } resource_handles[64];
+static int graphics_context_dummy;
+
+/**
+ TEST CONTROL
+ **/
+
+void stub_reset_counters() {
+  memset(&stub_counters, 0, sizeof(stub_counters));
+}
+
+// After a restart the cookies the last run saved are put back first.
+void stub_start_app() {
+  const char* path = getenv(RESTART_COOKIES_ENV);
+  if (path) {
+    FILE* file = fopen(path, "rb");
+    if (file) {
+      if (fread(cookies, sizeof(cookies), 1, file) != 1) {
+        memset(cookies, 0, sizeof(cookies));
+      }
+      fclose(file);
+    }
+    unlink(path);
+  }
+  pbl_main(NULL);
+}
+
+// The cookie store is written next to the test binary, which is run again
+// with the same arguments and finds the file's path in the environment.
+void stub_restart_app(char** argv) {
+  stub_cookie_deliver_all();
+  char path[256];
+  snprintf(path, sizeof(path), "%s.cookies", argv[0]);
+  FILE* file = fopen(path, "wb");
+  if (! file || fwrite(cookies, sizeof(cookies), 1, file) != 1) {
+    perror(path);
+    exit(1);
+  }
+  fclose(file);
+  setenv(RESTART_COOKIES_ENV, path, 1);
+  fflush(stdout);
+  execv(argv[0], argv);
+  perror(argv[0]);
+  exit(1);
+}
+
+bool stub_restarted() {
+  return getenv(RESTART_COOKIES_ENV) != NULL;
+}
+
+void stub_set_connected(bool is_connected) {
+  connected = is_connected;
+}
+
+// Returns the request sent since the last call, if there was one.
+bool stub_http_sent(StubRequest* request) {
+  if (! request_sent) {
+    return false;
+  }
+  request_sent = false;
+  if (request) {
+    *request = last_request;
+  }
+  return true;
+}
+
+void stub_http_reply(int32_t cookie, int http_status, DictionaryIterator* received) {
+  if (http_callbacks.success) {
+    http_callbacks.success(cookie, http_status, received, http_context);
+  }
+}
+
+void stub_http_fail(int32_t cookie, int http_status) {
+  if (http_callbacks.failure) {
+    http_callbacks.failure(cookie, http_status, http_context);
+  }
+}
+
+// A missing cookie is answered with a NULL tuple, as httpebble does.
+bool stub_cookie_deliver() {
+  if (! cookie_message_pending) {
+    return false;
+  }
+  StubCookieMessage message = cookie_message;
+  cookie_message_pending = false;
+  if (message.is_set) {
+    if (http_callbacks.cookie_set) {
+      http_callbacks.cookie_set(message.request_id, message.successful, http_context);
+    }
+    return true;
+  }
+
+  const uint8_t* data;
+  uint16_t length;
+  Tuple* result = NULL;
+  static uint8_t result_buffer[COOKIE_SIZE + 16];
+  if (stub_cookie_find(message.key, &data, &length)) {
+    DictionaryIterator iter;
+    dict_write_begin(&iter, result_buffer, sizeof(result_buffer));
+    dict_write_data(&iter, message.key, data, length);
+    dict_write_end(&iter);
+    result = iter.dictionary->head;
+  }
+  if (http_callbacks.cookie_get) {
+    http_callbacks.cookie_get(message.request_id, result, http_context);
+  }
+  return true;
+}
+
+void stub_cookie_deliver_all() {
+  while (stub_cookie_deliver()) {
+  }
+}
+
+bool stub_cookie_find(uint32_t key, const uint8_t** data, uint16_t* length) {
+  for (int c = 0; c < MAX_COOKIES; c += 1) {
+    if (cookies[c].used && cookies[c].key == key) {
+      *data = cookies[c].data;
+      *length = cookies[c].length;
+      return true;
+    }
+  }
+  return false;
+}
+
+void stub_cookie_clear() {
+  memset(cookies, 0, sizeof(cookies));
+  cookie_message_pending = false;
+}
+
+// Moves the clock on to the earliest timer and fires it.
+bool stub_timer_fire_next() {
+  stub_cookie_deliver_all();
+  int next = -1;
+  for (int t = 0; t < MAX_TIMERS; t += 1) {
+    if (timers[t].handle && (next < 0 || timers[t].due < timers[next].due)) {
+      next = t;
+    }
+  }
+  if (next < 0) {
+    return false;
+  }
+  StubTimer timer = timers[next];
+  timers[next].handle = 0;
+  if (timer.due > now_ms) {
+    uint32_t minutes = timer.due / 60000 - now_ms / 60000;
+    now_ms = timer.due;
+    int minute_of_day = now_tm.tm_hour * 60 + now_tm.tm_min + minutes;
+    now_tm.tm_yday += minute_of_day / (24 * 60);
+    now_tm.tm_hour = (minute_of_day / 60) % 24;
+    now_tm.tm_min = minute_of_day % 60;
+  }
+  if (app_handlers.timer_handler) {
+    app_handlers.timer_handler(NULL, timer.handle, timer.cookie);
+  }
+  return true;
+}
+
+uint32_t stub_timer_pending() {
+  uint32_t pending = 0;
+  for (int t = 0; t < MAX_TIMERS; t += 1) {
+    if (timers[t].handle) {
+      pending += 1;
+    }
+  }
+  return pending;
+}
+
+MenuLayer* stub_top_menu_layer() {
+  Window* top = window_stack_get_top_window();
+  for (int m = 0; m < menu_count && top; m += 1) {
+    if (menus[m]->scroll_layer.layer.parent == &top->layer) {
+      return menus[m];
+    }
+  }
+  return NULL;
+}
+
+int stub_menu_draw_frame() {
+  MenuLayer* menu = stub_top_menu_layer();
+  if (! menu) {
+    return 0;
+  }
+  int height = 0;
+  uint16_t sections = menu->callbacks.get_num_sections ? menu->callbacks.get_num_sections(menu, menu->callback_context) : 1;
+  for (uint16_t s = 0; s < sections; s += 1) {
+    draw_menu_section(menu, s, &height);
+  }
+  return height;
+}
+
+void stub_text_log_clear() {
+  text_log_count = 0;
+}
+
+const char* stub_text_log(uint16_t index) {
+  return index < text_log_count ? text_log[index] : NULL;
+}
+
+void stub_set_time(int hour, int minute) {
+  now_tm.tm_hour = hour;
+  now_tm.tm_min = minute;
+}
+
+/**
+ APP
+ **/
+
+void app_event_loop(AppContextRef app_task_ctx, PebbleAppHandlers* handlers) {
+  app_handlers = *handlers;
+  if (app_handlers.init_handler) {
+    app_handlers.init_handler(NULL);
+  }
+}
+
+void resource_init_current_app(ResBankVersion* version) {
+}
+
+void rockshot_main(PebbleAppHandlers* handlers) {
+}
+
+void rockshot_init(AppContextRef ctx) {
+}
+
+AppTimerHandle app_timer_send_event(AppContextRef app_ctx, uint32_t timeout_ms, uint32_t cookie) {
+  for (int t = 0; t < MAX_TIMERS; t += 1) {
+    if (! timers[t].handle) {
+      timers[t].handle = next_timer_handle;
+      timers[t].due = now_ms + timeout_ms;
+      timers[t].cookie = cookie;
+      next_timer_handle += 1;
+      stub_counters.timers_started += 1;
+      return timers[t].handle;
+    }
+  }
+  fprintf(stderr, "stub: out of timers\n");
+  abort();
+}
+
+bool app_timer_cancel_event(AppContextRef app_ctx_ref, AppTimerHandle handle) {
+  for (int t = 0; t < MAX_TIMERS; t += 1) {
+    if (handle && timers[t].handle == handle) {
+      timers[t].handle = 0;
+      stub_counters.timers_cancelled += 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+void get_time(PblTm* time) {
+  *time = now_tm;
+  time->tm_sec = (now_ms / 1000) % 60;
+}
+
+void string_format_time(char* ptr, size_t maxsize, const char* format, const PblTm* timeptr) {
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  tm.tm_sec = timeptr->tm_sec;
+  tm.tm_min = timeptr->tm_min;
+  tm.tm_hour = timeptr->tm_hour;
+  tm.tm_mday = timeptr->tm_mday;
+  tm.tm_mon = timeptr->tm_mon;
+  tm.tm_year = timeptr->tm_year;
+  tm.tm_wday = timeptr->tm_wday;
+  tm.tm_yday = timeptr->tm_yday;
+  if (strftime(ptr, maxsize, format, &tm) == 0 && maxsize > 0) {
+    ptr[0] = '\0';
+  }
+}
+
+bool clock_is_24h_style(void) {
+  return true;
+}
+
+void vibes_enqueue_custom_pattern(VibePattern pattern) {
+  stub_counters.vibes += 1;
+}
+
+/**
+ DICTIONARY
+ **/
+
+Tuple* dict_find(const DictionaryIterator* iter, const uint32_t key) {
+  DictionaryIterator find = *iter;
+  for (Tuple* tuple = dict_read_first(&find); tuple; tuple = dict_read_next(&find)) {
+    if (tuple->key == key) {
+      return tuple;
+    }
+  }
+  return NULL;
+}
+
+Tuple* dict_read_first(DictionaryIterator* iter) {
+  iter->cursor = iter->dictionary->head;
+  if (iter->dictionary->count == 0 || ! tuple_fits(iter, iter->cursor)) {
+    return NULL;
+  }
+  return iter->cursor;
+}
+
+Tuple* dict_read_next(DictionaryIterator* iter) {
+  if (! iter->cursor || ! tuple_fits(iter, iter->cursor)) {
+    return NULL;
+  }
+  iter->cursor = (Tuple*)((uint8_t*)iter->cursor + TUPLE_HEADER_SIZE + iter->cursor->length);
+  return tuple_fits(iter, iter->cursor) ? iter->cursor : NULL;
+}
+
+Tuple* dict_read_begin_from_buffer(DictionaryIterator* iter, const uint8_t* const buffer, const uint16_t size) {
+  iter->dictionary = (Dictionary*)buffer;
+  iter->end = buffer + size;
+  if (size < sizeof(Dictionary)) {
+    iter->cursor = NULL;
+    return NULL;
+  }
+  return dict_read_first(iter);
+}
+
+DictionaryResult dict_write_begin(DictionaryIterator* iter, uint8_t* const buffer, const uint16_t size) {
+  if (size < sizeof(Dictionary)) {
+    return DICT_NOT_ENOUGH_STORAGE;
+  }
+  iter->dictionary = (Dictionary*)buffer;
+  iter->dictionary->count = 0;
+  iter->end = buffer + size;
+  iter->cursor = iter->dictionary->head;
+  return DICT_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator* iter, const uint32_t key, const uint8_t* const data, const uint16_t size) {
+  return write_tuple(iter, key, TUPLE_BYTE_ARRAY, data, size) ? DICT_OK : DICT_NOT_ENOUGH_STORAGE;
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator* iter, const uint32_t key, const char* const cstring) {
+  return write_tuple(iter, key, TUPLE_CSTRING, cstring, strlen(cstring) + 1) ? DICT_OK : DICT_NOT_ENOUGH_STORAGE;
+}
+
+DictionaryResult dict_write_int(DictionaryIterator* iter, const uint32_t key, const void* integer, const uint8_t width_bytes, const bool is_signed) {
+  if (width_bytes != 1 && width_bytes != 2 && width_bytes != 4) {
+    return DICT_INVALID_ARGS;
+  }
+  return write_tuple(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes) ? DICT_OK : DICT_NOT_ENOUGH_STORAGE;
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator* iter, const uint32_t key, const uint8_t value) {
+  return dict_write_int(iter, key, &value, 1, false);
+}
+
+DictionaryResult dict_write_uint16(DictionaryIterator* iter, const uint32_t key, const uint16_t value) {
+  return dict_write_int(iter, key, &value, 2, false);
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator* iter, const uint32_t key, const uint32_t value) {
+  return dict_write_int(iter, key, &value, 4, false);
+}
+
+DictionaryResult dict_write_int8(DictionaryIterator* iter, const uint32_t key, const int8_t value) {
+  return dict_write_int(iter, key, &value, 1, true);
+}
+
+DictionaryResult dict_write_int16(DictionaryIterator* iter, const uint32_t key, const int16_t value) {
+  return dict_write_int(iter, key, &value, 2, true);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator* iter, const uint32_t key, const int32_t value) {
+  return dict_write_int(iter, key, &value, 4, true);
+}
+
+// Leaves the cursor at the end, where diagnostics_dict_size measures to.
+uint32_t dict_write_end(DictionaryIterator* iter) {
+  iter->end = iter->cursor;
+  return (uint8_t*)iter->cursor - (uint8_t*)iter->dictionary;
+}
+
+/**
+ WINDOWS AND LAYERS
+ **/
+
+void window_init(Window* window, const char* debug_name) {
+  memset(window, 0, sizeof(Window));
+  window->debug_name = debug_name;
+  window->layer.frame = GRect(0, 0, 144, 152);
+  window->layer.bounds = GRect(0, 0, 144, 152);
+}
+
+void window_set_window_handlers(Window* window, WindowHandlers handlers) {
+  window->window_handlers = handlers;
+}
+
+void window_stack_push(Window* window, bool animated) {
+  if (window_count >= MAX_WINDOWS) {
+    fprintf(stderr, "stub: window stack full\n");
+    abort();
+  }
+  Window* top = window_stack_get_top_window();
+  if (top && top->window_handlers.disappear) {
+    top->window_handlers.disappear(top);
+  }
+  window_stack[window_count] = window;
+  window_count += 1;
+  stub_counters.window_pushes += 1;
+  if (! window->is_loaded) {
+    window->is_loaded = true;
+    if (window->window_handlers.load) {
+      window->window_handlers.load(window);
+    }
+  }
+  if (window->window_handlers.appear) {
+    window->window_handlers.appear(window);
+  }
+}
+
+Window* window_stack_pop(bool animated) {
+  if (window_count == 0) {
+    return NULL;
+  }
+  window_count -= 1;
+  Window* window = window_stack[window_count];
+  if (window->window_handlers.disappear) {
+    window->window_handlers.disappear(window);
+  }
+  window->is_loaded = false;
+  if (window->window_handlers.unload) {
+    window->window_handlers.unload(window);
+  }
+  Window* top = window_stack_get_top_window();
+  if (top && top->window_handlers.appear) {
+    top->window_handlers.appear(top);
+  }
+  return window;
+}
+
+Window* window_stack_get_top_window(void) {
+  return window_count ? window_stack[window_count - 1] : NULL;
+}
+
+void layer_add_child(Layer* parent, Layer* child) {
+  child->parent = parent;
+}
+
+void layer_mark_dirty(Layer* layer) {
+  stub_counters.layer_dirties += 1;
+}
+
+void menu_layer_init(MenuLayer* menu_layer, GRect frame) {
+  stub_counters.layer_inits += 1;
+  memset(menu_layer, 0, sizeof(MenuLayer));
+  menu_layer->scroll_layer.layer.frame = frame;
+  menu_layer->scroll_layer.layer.bounds = GRect(0, 0, frame.size.w, frame.size.h);
+  for (int m = 0; m < menu_count; m += 1) {
+    if (menus[m] == menu_layer) {
+      return;
+    }
+  }
+  if (menu_count < MAX_MENUS) {
+    menus[menu_count] = menu_layer;
+    menu_count += 1;
+  }
+}
+
+void menu_layer_set_callbacks(MenuLayer* menu_layer, void* callback_context, MenuLayerCallbacks callbacks) {
+  menu_layer->callbacks = callbacks;
+  menu_layer->callback_context = callback_context;
+}
+
+void menu_layer_set_click_config_onto_window(MenuLayer* menu_layer, Window* window) {
+}
+
+Layer* menu_layer_get_layer(MenuLayer* menu_layer) {
+  return &menu_layer->scroll_layer.layer;
+}
+
+void menu_layer_reload_data(MenuLayer* menu_layer) {
+  stub_counters.menu_reloads += 1;
+}
+
+void menu_cell_basic_header_draw(GContext* ctx, const Layer* cell_layer, const char* title) {
+  stub_counters.text_draws += 1;
+}
+
+void scroll_layer_init(ScrollLayer* scroll_layer, GRect frame) {
+  stub_counters.layer_inits += 1;
+  memset(scroll_layer, 0, sizeof(ScrollLayer));
+  scroll_layer->layer.frame = frame;
+}
+
+void scroll_layer_set_click_config_onto_window(ScrollLayer* scroll_layer, Window* window) {
+}
+
+void scroll_layer_add_child(ScrollLayer* scroll_layer, Layer* child) {
+  child->parent = &scroll_layer->layer;
+}
+
+void scroll_layer_set_content_size(ScrollLayer* scroll_layer, GSize size) {
+  scroll_layer->content_size = size;
+}
+
+void scroll_layer_set_content_offset(ScrollLayer* scroll_layer, GPoint offset, bool animated) {
+  scroll_layer->content_offset = offset;
+}
+
+void text_layer_init(TextLayer* text_layer, GRect frame) {
+  stub_counters.layer_inits += 1;
+  memset(text_layer, 0, sizeof(TextLayer));
+  text_layer->layer.frame = frame;
+}
+
+void text_layer_set_text(TextLayer* text_layer, const char* text) {
+  text_layer->text = text;
+}
+
+void text_layer_set_font(TextLayer* text_layer, GFont font) {
+  text_layer->font = font;
+}
+
+void text_layer_set_text_color(TextLayer* text_layer, GColor color) {
+}
+
+void text_layer_set_background_color(TextLayer* text_layer, GColor color) {
+}
+
+void text_layer_set_text_alignment(TextLayer* text_layer, GTextAlignment alignment) {
+}
+
+void text_layer_set_overflow_mode(TextLayer* text_layer, GTextOverflowMode overflow_mode) {
+}
+
+void text_layer_set_size(TextLayer* text_layer, const GSize max_size) {
+  text_layer->layer.frame.size = max_size;
+}
+
+// Assumes 20 characters to a line of 24px text.
+GSize text_layer_get_max_used_size(GContext* ctx, TextLayer* text_layer) {
+  stub_counters.text_measures += 1;
+  int length = text_layer->text ? strlen(text_layer->text) : 0;
+  return GSize(text_layer->layer.frame.size.w, (length / 20 + 1) * 24);
+}
+
+/**
+ GRAPHICS AND RESOURCES
+ **/
+
+GContext* app_get_current_graphics_context(void) {
+  return (GContext*)&graphics_context_dummy;
+}
+
+void graphics_context_set_text_color(GContext* ctx, GColor color) {
+}
+
+void graphics_context_set_fill_color(GContext* ctx, GColor color) {
+}
+
+void graphics_fill_circle(GContext* ctx, GPoint p, uint16_t radius) {
+}
+
+void graphics_draw_bitmap_in_rect(GContext* ctx, const GBitmap* bitmap, GRect rect) {
+  stub_counters.bitmap_draws += 1;
+}
+
+void graphics_text_draw(GContext* ctx, const char* text, const GFont font, const GRect box, const GTextOverflowMode overflow_mode, const GTextAlignment alignment, const GTextLayoutCacheRef layout) {
+  stub_counters.text_draws += 1;
+  if (text_log_count < MAX_TEXT_LOG) {
+    text_log[text_log_count] = text;
+    text_log_count += 1;
+  }
+}
+
+bool gbitmap_init_as_sub_bitmap(GBitmap* sub_bitmap, const GBitmap* base_bitmap, GRect sub_rect) {
+  *sub_bitmap = *base_bitmap;
+  sub_bitmap->bounds = sub_rect;
+  return true;
+}
+
+bool heap_bitmap_init(HeapBitmap* image, int resource_id) {
+  memset(image, 0, sizeof(HeapBitmap));
+  image->data = malloc(4);
+  image->bmp.addr = image->data;
+  stub_counters.bitmaps_loaded += 1;
+  return true;
+}
+
+void heap_bitmap_deinit(HeapBitmap* image) {
+  free(image->data);
+  image->data = NULL;
+  stub_counters.bitmaps_unloaded += 1;
+}
+
+ResHandle resource_get_handle(uint32_t file_id) {
+  return (ResHandle)&resource_handles[file_id % 64];
+}
+
+GFont fonts_get_system_font(const char* font_key) {
+  return (GFont)font_key;
+}
+
+GFont fonts_load_custom_font(ResHandle resource) {
+  stub_counters.fonts_loaded += 1;
+  return (GFont)resource;
+}
+
+void fonts_unload_custom_font(GFont font) {
+  stub_counters.fonts_unloaded += 1;
+}
+
+/**
+ HTTPEBBLE
+ **/
+
+bool http_register_callbacks(HTTPCallbacks callbacks, void* context) {
+  http_callbacks = callbacks;
+  http_context = context;
+  return true;
+}
+
+void http_set_app_id(int32_t new_app_id) {
+}
+
+HTTPResult http_out_get(const char* url, int32_t cookie, DictionaryIterator** iter) {
+  stub_counters.http_gets += 1;
+  if (! connected) {
+    return HTTP_NOT_CONNECTED;
+  }
+  if (cookie_message_pending) {
+    stub_counters.cookie_busy += 1;
+    return HTTP_BUSY;
+  }
+  strncpy(last_request.url, url, STUB_URL_SIZE - 1);
+  last_request.url[STUB_URL_SIZE - 1] = '\0';
+  last_request.cookie = cookie;
+  dict_write_begin(&request_iter, last_request.body, sizeof(last_request.body));
+  *iter = &request_iter;
+  request_open = true;
+  return HTTP_OK;
+}
+
+HTTPResult http_out_send() {
+  if (! request_open) {
+    return HTTP_INVALID_ARGS;
+  }
+  last_request.body_size = dict_write_end(&request_iter);
+  request_open = false;
+  request_sent = true;
+  stub_counters.http_sends += 1;
+  stub_counters.http_bytes_sent += last_request.body_size;
+  return HTTP_OK;
+}
+
+HTTPResult http_cookie_get(int32_t request_id, uint32_t key) {
+  stub_counters.cookie_gets += 1;
+  if (cookie_message_pending) {
+    stub_counters.cookie_busy += 1;
+    return HTTP_BUSY;
+  }
+  cookie_message = (StubCookieMessage){ .request_id = request_id, .key = key };
+  cookie_message_pending = true;
+  return HTTP_OK;
+}
+
+HTTPResult http_cookie_set_start(int32_t request_id, DictionaryIterator** iter) {
+  if (cookie_message_pending) {
+    stub_counters.cookie_busy += 1;
+    return HTTP_BUSY;
+  }
+  cookie_message = (StubCookieMessage){ .request_id = request_id, .is_set = true };
+  dict_write_begin(&cookie_iter, cookie_buffer, sizeof(cookie_buffer));
+  *iter = &cookie_iter;
+  return HTTP_OK;
+}
+
+// Every tuple written is kept under its own key, replacing what was there.
+// The write is answered, successful or not, by stub_cookie_deliver.
+HTTPResult http_cookie_set_end() {
+  uint32_t size = dict_write_end(&cookie_iter);
+  DictionaryIterator iter;
+  for (Tuple* tuple = dict_read_begin_from_buffer(&iter, cookie_buffer, size); tuple; tuple = dict_read_next(&iter)) {
+    int slot = -1;
+    for (int c = 0; c < MAX_COOKIES; c += 1) {
+      if (cookies[c].used && cookies[c].key == tuple->key) {
+        slot = c;
+        break;
+      }
+      if (! cookies[c].used && slot < 0) {
+        slot = c;
+      }
+    }
+    if (slot < 0 || tuple->length > COOKIE_SIZE) {
+      cookie_message.successful = false;
+      cookie_message_pending = true;
+      return HTTP_OK;
+    }
+    cookies[slot].used = true;
+    cookies[slot].key = tuple->key;
+    cookies[slot].length = tuple->length;
+    memcpy(cookies[slot].data, tuple->value->data, tuple->length);
+  }
+  stub_counters.cookie_sets += 1;
+  cookie_message.successful = true;
+  cookie_message_pending = true;
+  return HTTP_OK;
+}
+
+/**
+ PRIVATE FUNCTIONS
+ **/
+
+Tuple* write_tuple(DictionaryIterator* iter, uint32_t key, TupleType type, const void* data, uint16_t length) {
+  uint8_t* cursor = (uint8_t*)iter->cursor;
+  if (cursor + TUPLE_HEADER_SIZE + length > (uint8_t*)iter->end) {
+    return NULL;
+  }
+  Tuple* tuple = iter->cursor;
+  tuple->key = key;
+  tuple->type = type;
+  tuple->length = length;
+  memcpy(tuple->value->data, data, length);
+  iter->cursor = (Tuple*)(cursor + TUPLE_HEADER_SIZE + length);
+  iter->dictionary->count += 1;
+  return tuple;
+}
+
+bool tuple_fits(const DictionaryIterator* iter, const Tuple* tuple) {
+  const uint8_t* start = (const uint8_t*)tuple;
+  const uint8_t* end = (const uint8_t*)iter->end;
+  return start + TUPLE_HEADER_SIZE <= end && start + TUPLE_HEADER_SIZE + tuple->length <= end;
+}
+
+void draw_menu_section(MenuLayer* menu, uint16_t section, int* height) {
+  void* context = menu->callback_context;
+  if (menu->callbacks.get_header_height) {
+    stub_counters.header_height_calls += 1;
+    *height += menu->callbacks.get_header_height(menu, section, context);
+  }
+  if (menu->callbacks.draw_header) {
+    stub_counters.header_draws += 1;
+    menu->callbacks.draw_header((GContext*)&graphics_context_dummy, &menu->scroll_layer.layer, section, context);
+  }
+  stub_counters.num_rows_calls += 1;
+  uint16_t rows = menu->callbacks.get_num_rows(menu, section, context);
+  for (uint16_t r = 0; r < rows; r += 1) {
+    MenuIndex index = { .section = section, .row = r };
+    if (menu->callbacks.get_cell_height) {
+      stub_counters.cell_height_calls += 1;
+      *height += menu->callbacks.get_cell_height(menu, &index, context);
+    }
+    if (menu->callbacks.draw_row) {
+      stub_counters.row_draws += 1;
+      menu->callbacks.draw_row((GContext*)&graphics_context_dummy, &menu->scroll_layer.layer, &index, context);
+    }
+  }
+}
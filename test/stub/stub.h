@@ -0,0 +1,120 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef STUB_H
+#define STUB_H
+
+// Lets tests and benchmarks drive the stub SDK: deliver responses and
+// cookies, fire timers, draw a menu frame and read what the app did.
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+
+#define STUB_URL_SIZE 128
+#define STUB_MESSAGE_SIZE 256
+
+typedef struct {
+  uint32_t window_pushes;
+  uint32_t layer_inits;
+  uint32_t text_measures;
+  uint32_t menu_reloads;
+  uint32_t layer_dirties;
+  uint32_t num_rows_calls;
+  uint32_t cell_height_calls;
+  uint32_t header_height_calls;
+  uint32_t row_draws;
+  uint32_t header_draws;
+  uint32_t text_draws;
+  uint32_t bitmap_draws;
+  uint32_t fonts_loaded;
+  uint32_t fonts_unloaded;
+  uint32_t bitmaps_loaded;
+  uint32_t bitmaps_unloaded;
+  uint32_t vibes;
+  uint32_t http_gets;
+  uint32_t http_sends;
+  uint32_t http_bytes_sent;
+  uint32_t cookie_gets;
+  uint32_t cookie_sets;
+  uint32_t cookie_busy;
+  uint32_t timers_started;
+  uint32_t timers_cancelled;
+} StubCounters;
+
+typedef struct {
+  char url[STUB_URL_SIZE];
+  int32_t cookie;
+  uint8_t body[STUB_MESSAGE_SIZE];
+  uint16_t body_size;
+} StubRequest;
+
+extern StubCounters stub_counters;
+
+void stub_reset_counters();
+
+// Runs pbl_main, which hands its handlers to app_event_loop, and calls the
+// init handler.
+void stub_start_app();
+
+// Runs the test binary again as a new launch of the app, keeping only the
+// cookie store. stub_restarted tells the two runs apart.
+void stub_restart_app(char** argv);
+bool stub_restarted();
+
+// HTTP. While the link is down http_out_get fails with HTTP_NOT_CONNECTED.
+void stub_set_connected(bool connected);
+bool stub_http_sent(StubRequest* request);
+void stub_http_reply(int32_t cookie, int http_status, DictionaryIterator* received);
+void stub_http_fail(int32_t cookie, int http_status);
+
+// Cookie store. Like httpebble, it takes one cookie read or write at a
+// time: until that message is answered, another read, write or request
+// is refused with HTTP_BUSY. Firing a timer answers it first.
+bool stub_cookie_deliver();
+void stub_cookie_deliver_all();
+bool stub_cookie_find(uint32_t key, const uint8_t** data, uint16_t* length);
+void stub_cookie_clear();
+
+// Loopback, in loopback.c. Requests the app sends are posted to a running
+// tools/fake-api.py and its replies delivered, one request per call.
+bool stub_loopback_start(const char* host, int port);
+bool stub_loopback_deliver();
+uint32_t stub_loopback_errors();
+
+// Timers. Time only moves when a timer is fired.
+bool stub_timer_fire_next();
+uint32_t stub_timer_pending();
+
+// Calls every menu callback of the menu layer on the top window once, the
+// way a full scroll through the list would, and returns the total height.
+int stub_menu_draw_frame();
+MenuLayer* stub_top_menu_layer();
+
+// The texts drawn with graphics_text_draw since the log was last cleared,
+// oldest first, or NULL past the end.
+void stub_text_log_clear();
+const char* stub_text_log(uint16_t index);
+
+void stub_set_time(int hour, int minute);
+
+#endif // STUB_H
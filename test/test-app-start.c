@@ -0,0 +1,73 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+#include "test.h"
+#include "request-scheduler.h"
+#include "diagnostics.h"
+#include "line-manifest.h"
+#include "outbox.h"
+#include "wnd-tube-status.h"
+#include "wnd-next-bus.h"
+#include "wnd-line-detail.h"
+
+// Starts the app the way the watch does and checks that every request it
+// sends found a slot in the scheduler.
+
+static const int32_t app_requests[] = {
+  HTTP_TUBE_STATUS,
+  HTTP_NEXT_BUS,
+  HTTP_LINE_DETAIL,
+  HTTP_LINE_MANIFEST,
+  HTTP_OUTBOX
+};
+
+static void test_every_request_registered() {
+  CHECK_EQUAL(diagnostics_counter(DIAG_UNREGISTERED), 0);
+  for (unsigned r = 0; r < sizeof(app_requests) / sizeof(int32_t); r += 1) {
+    request_scheduler_send(app_requests[r]);
+    CHECK_EQUAL(request_scheduler_state(app_requests[r]), REQUEST_QUEUED);
+  }
+  CHECK_EQUAL(diagnostics_counter(DIAG_UNREGISTERED), 0);
+}
+
+static void test_full_scheduler_reports_unregistered() {
+  static ScheduledRequest extra[8];
+  bool registered = true;
+  for (int r = 0; r < 8 && registered; r += 1) {
+    extra[r].cookie = 9000 + r;
+    registered = request_scheduler_register(&extra[r]);
+  }
+  CHECK(! registered);
+  CHECK_EQUAL(diagnostics_counter(DIAG_UNREGISTERED), 1);
+}
+
+int main(int argc, char** argv) {
+  stub_start_app();
+  stub_cookie_deliver_all();
+  RUN_TEST(test_every_request_registered);
+  RUN_TEST(test_full_scheduler_reports_unregistered);
+  return TEST_RESULT();
+}
@@ -0,0 +1,215 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "stub.h"
+#include "test.h"
+#include "chunk-assembly.h"
+
+// The payload is split into four ten byte chunks.
+#define PAYLOAD "0123456789abcdefghijABCDEFGHIJ!@#$%^&*()"
+#define PAYLOAD_LENGTH 40
+#define CHUNK_LENGTH 10
+#define CHUNK_COUNT 4
+
+static ChunkAssembly assembly;
+static uint8_t arena[64];
+static int chunks_seen = 0;
+static int completions = 0;
+static uint16_t completed_length = 0;
+
+static void on_chunk(uint16_t transfer, const uint8_t* data, uint16_t offset, uint16_t length) {
+  chunks_seen += 1;
+}
+
+static void on_complete(uint16_t transfer, const uint8_t* data, uint16_t length) {
+  completions += 1;
+  completed_length = length;
+}
+
+static void start() {
+  chunk_assembly_init(&assembly, arena, sizeof(arena), on_chunk, on_complete);
+  memset(arena, '.', sizeof(arena));
+  chunks_seen = 0;
+  completions = 0;
+  completed_length = 0;
+}
+
+static ChunkResult add(uint16_t transfer, uint8_t index, uint16_t offset, uint16_t length) {
+  uint8_t buffer[96];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_uint16(&iter, CHUNK_KEY_TRANSFER, transfer);
+  dict_write_uint8(&iter, CHUNK_KEY_INDEX, index);
+  dict_write_uint8(&iter, CHUNK_KEY_COUNT, CHUNK_COUNT);
+  dict_write_uint16(&iter, CHUNK_KEY_OFFSET, offset);
+  dict_write_uint16(&iter, CHUNK_KEY_TOTAL, PAYLOAD_LENGTH);
+  dict_write_data(&iter, CHUNK_KEY_DATA, (const uint8_t*)PAYLOAD + offset, length);
+  dict_write_end(&iter);
+  return chunk_assembly_add(&assembly, &iter);
+}
+
+static ChunkResult add_chunk(uint16_t transfer, uint8_t index) {
+  return add(transfer, index, index * CHUNK_LENGTH, CHUNK_LENGTH);
+}
+
+// Returns the chunk index the next request would ask for, or -1 if the
+// request would not mention the transfer at all.
+static int requested_chunk() {
+  uint8_t buffer[32];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  chunk_assembly_write_request(&assembly, &iter);
+  uint32_t size = dict_write_end(&iter);
+  DictionaryIterator read;
+  if (! dict_read_begin_from_buffer(&read, buffer, size)) {
+    return -1;
+  }
+  Tuple* tuple = dict_find(&read, CHUNK_KEY_INDEX);
+  return tuple ? tuple->value->uint8 : -1;
+}
+
+static bool payload_assembled() {
+  return completions == 1 && completed_length == PAYLOAD_LENGTH && memcmp(arena, PAYLOAD, PAYLOAD_LENGTH) == 0;
+}
+
+static void test_chunks_in_order() {
+  start();
+  CHECK_EQUAL(requested_chunk(), -1);
+  CHECK_EQUAL(add_chunk(7, 0), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(requested_chunk(), 1);
+  CHECK_EQUAL(add_chunk(7, 1), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(7, 2), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(7, 3), CHUNK_COMPLETE);
+  CHECK_EQUAL(requested_chunk(), -1);
+  CHECK(payload_assembled());
+}
+
+static void test_chunks_out_of_order() {
+  start();
+  CHECK_EQUAL(add_chunk(7, 2), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(7, 0), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(7, 3), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(requested_chunk(), 1);
+  CHECK_EQUAL(add_chunk(7, 1), CHUNK_COMPLETE);
+  CHECK(payload_assembled());
+}
+
+static void test_duplicate_chunks_are_ignored() {
+  start();
+  CHECK_EQUAL(add_chunk(7, 0), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(7, 0), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(7, 1), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(7, 1), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(7, 2), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(7, 3), CHUNK_COMPLETE);
+  CHECK_EQUAL(chunks_seen, CHUNK_COUNT);
+  CHECK(payload_assembled());
+}
+
+static void test_lost_chunk_is_asked_for_again() {
+  start();
+  CHECK_EQUAL(add_chunk(7, 0), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(7, 2), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(7, 3), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(requested_chunk(), 1);
+  CHECK_EQUAL(completions, 0);
+  CHECK_EQUAL(add_chunk(7, 1), CHUNK_COMPLETE);
+  CHECK(payload_assembled());
+}
+
+static void test_new_transfer_starts_over() {
+  start();
+  CHECK_EQUAL(add_chunk(7, 0), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(7, 1), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(8, 2), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(requested_chunk(), 0);
+  CHECK_EQUAL(add_chunk(8, 3), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(8, 0), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add_chunk(8, 1), CHUNK_COMPLETE);
+  CHECK(payload_assembled());
+}
+
+static void test_chunks_that_leave_a_gap_fail() {
+  start();
+  CHECK_EQUAL(add(7, 0, 0, CHUNK_LENGTH), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add(7, 1, 10, CHUNK_LENGTH), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add(7, 2, 10, CHUNK_LENGTH), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add(7, 3, 30, CHUNK_LENGTH), CHUNK_ERROR);
+  CHECK_EQUAL(completions, 0);
+  CHECK_EQUAL(requested_chunk(), -1);
+}
+
+static void test_overlapping_chunks_complete() {
+  start();
+  CHECK_EQUAL(add(7, 0, 0, 15), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add(7, 1, 10, 10), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add(7, 2, 18, 12), CHUNK_INCOMPLETE);
+  CHECK_EQUAL(add(7, 3, 30, 10), CHUNK_COMPLETE);
+  CHECK(payload_assembled());
+}
+
+static void test_chunk_past_total_fails() {
+  start();
+  CHECK_EQUAL(add(7, 3, 35, CHUNK_LENGTH), CHUNK_ERROR);
+  CHECK_EQUAL(chunks_seen, 0);
+}
+
+static void test_numbers_must_be_unsigned_integers() {
+  start();
+  uint8_t buffer[96];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_cstring(&iter, CHUNK_KEY_TRANSFER, "7");
+  dict_write_uint8(&iter, CHUNK_KEY_INDEX, 0);
+  dict_write_uint8(&iter, CHUNK_KEY_COUNT, 1);
+  dict_write_uint8(&iter, CHUNK_KEY_OFFSET, 0);
+  dict_write_uint8(&iter, CHUNK_KEY_TOTAL, 4);
+  dict_write_data(&iter, CHUNK_KEY_DATA, (const uint8_t*)PAYLOAD, 4);
+  dict_write_end(&iter);
+  CHECK_EQUAL(chunk_assembly_add(&assembly, &iter), CHUNK_ERROR);
+
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_uint8(&iter, CHUNK_KEY_TRANSFER, 7);
+  dict_write_uint8(&iter, CHUNK_KEY_INDEX, 0);
+  dict_write_uint8(&iter, CHUNK_KEY_COUNT, 1);
+  dict_write_int8(&iter, CHUNK_KEY_OFFSET, -1);
+  dict_write_uint8(&iter, CHUNK_KEY_TOTAL, 4);
+  dict_write_data(&iter, CHUNK_KEY_DATA, (const uint8_t*)PAYLOAD, 4);
+  dict_write_end(&iter);
+  CHECK_EQUAL(chunk_assembly_add(&assembly, &iter), CHUNK_ERROR);
+  CHECK_EQUAL(chunks_seen, 0);
+}
+
+int main(int argc, char** argv) {
+  RUN_TEST(test_chunks_in_order);
+  RUN_TEST(test_chunks_out_of_order);
+  RUN_TEST(test_duplicate_chunks_are_ignored);
+  RUN_TEST(test_lost_chunk_is_asked_for_again);
+  RUN_TEST(test_new_transfer_starts_over);
+  RUN_TEST(test_chunks_that_leave_a_gap_fail);
+  RUN_TEST(test_overlapping_chunks_complete);
+  RUN_TEST(test_chunk_past_total_fails);
+  RUN_TEST(test_numbers_must_be_unsigned_integers);
+  return TEST_RESULT();
+}
@@ -0,0 +1,70 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "pebble_fonts.h"
+#include "stub.h"
+#include "test.h"
+#include "font-manager.h"
+
+static void test_font_unloads_with_last_reference() {
+  stub_reset_counters();
+  font_manager_get_font(RESOURCE_ID_FONT_TFL_15);
+  font_manager_get_font(RESOURCE_ID_FONT_TFL_15);
+  CHECK_EQUAL(stub_counters.fonts_loaded, 1);
+  font_manager_release(RESOURCE_ID_FONT_TFL_15);
+  CHECK_EQUAL(stub_counters.fonts_unloaded, 0);
+  font_manager_release(RESOURCE_ID_FONT_TFL_15);
+  CHECK_EQUAL(stub_counters.fonts_unloaded, 1);
+  font_manager_release(RESOURCE_ID_FONT_TFL_15);
+  CHECK_EQUAL(stub_counters.fonts_unloaded, 1);
+}
+
+static void test_released_font_loads_again() {
+  stub_reset_counters();
+  font_manager_get_font(RESOURCE_ID_FONT_TFL_BOLD_18);
+  font_manager_release(RESOURCE_ID_FONT_TFL_BOLD_18);
+  font_manager_get_font(RESOURCE_ID_FONT_TFL_BOLD_18);
+  CHECK_EQUAL(stub_counters.fonts_loaded, 2);
+  font_manager_release(RESOURCE_ID_FONT_TFL_BOLD_18);
+  CHECK_EQUAL(stub_counters.fonts_unloaded, 2);
+}
+
+static void test_released_bitmap_stays_until_purged() {
+  stub_reset_counters();
+  font_manager_get_bitmap(RESOURCE_ID_ICON_ATLAS);
+  font_manager_release(RESOURCE_ID_ICON_ATLAS);
+  font_manager_get_bitmap(RESOURCE_ID_ICON_ATLAS);
+  font_manager_release(RESOURCE_ID_ICON_ATLAS);
+  CHECK_EQUAL(stub_counters.bitmaps_loaded, 1);
+  CHECK_EQUAL(stub_counters.bitmaps_unloaded, 0);
+  font_manager_purge();
+  CHECK_EQUAL(stub_counters.bitmaps_unloaded, 1);
+}
+
+int main(int argc, char** argv) {
+  RUN_TEST(test_font_unloads_with_last_reference);
+  RUN_TEST(test_released_font_loads_again);
+  RUN_TEST(test_released_bitmap_stays_until_purged);
+  return TEST_RESULT();
+}
@@ -0,0 +1,113 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+#include "test.h"
+#include "request-scheduler.h"
+#include "chunk-assembly.h"
+#include "wnd-line-detail.h"
+
+#define KEY_CODE 0
+
+static const char* sent_code() {
+  static StubRequest request;
+  while (! stub_http_sent(&request)) {
+    if (! stub_timer_fire_next()) {
+      return "";
+    }
+  }
+  DictionaryIterator iter;
+  Tuple* tuple = dict_read_begin_from_buffer(&iter, request.body, request.body_size);
+  tuple = tuple ? dict_find(&iter, KEY_CODE) : NULL;
+  return tuple ? tuple->value->cstring : "";
+}
+
+static void reply_with_detail(const char* code, const char* detail) {
+  uint8_t buffer[128];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_cstring(&iter, KEY_CODE, code);
+  dict_write_uint8(&iter, CHUNK_KEY_TRANSFER, 1);
+  dict_write_uint8(&iter, CHUNK_KEY_INDEX, 0);
+  dict_write_uint8(&iter, CHUNK_KEY_COUNT, 1);
+  dict_write_uint8(&iter, CHUNK_KEY_OFFSET, 0);
+  dict_write_uint8(&iter, CHUNK_KEY_TOTAL, strlen(detail));
+  dict_write_data(&iter, CHUNK_KEY_DATA, (const uint8_t*)detail, strlen(detail));
+  dict_write_end(&iter);
+  stub_http_reply(HTTP_LINE_DETAIL, 200, &iter);
+}
+
+static void test_detail_is_requested_for_the_line() {
+  wnd_line_detail_show("BA", "Bakerloo", 1);
+  CHECK(strcmp(sent_code(), "BA") == 0);
+  reply_with_detail("BA", "Minor delays.");
+  CHECK_EQUAL(request_scheduler_state(HTTP_LINE_DETAIL), REQUEST_IDLE);
+  window_stack_pop(false);
+}
+
+static void test_late_reply_sends_the_current_line() {
+  wnd_line_detail_show("CE", "Central", 1);
+  CHECK(strcmp(sent_code(), "CE") == 0);
+  window_stack_pop(false);
+  wnd_line_detail_show("DI", "District", 1);
+  CHECK(! stub_http_sent(NULL));
+  reply_with_detail("CE", "Part suspended.");
+  CHECK(strcmp(sent_code(), "DI") == 0);
+  reply_with_detail("DI", "Good service.");
+  CHECK_EQUAL(request_scheduler_state(HTTP_LINE_DETAIL), REQUEST_IDLE);
+  window_stack_pop(false);
+}
+
+static void test_code_must_match_exactly() {
+  wnd_line_detail_show("HC", "Hammersmith", 1);
+  CHECK(strcmp(sent_code(), "HC") == 0);
+  reply_with_detail("HCX", "Severe delays.");
+  CHECK(strcmp(sent_code(), "HC") == 0);
+  reply_with_detail("HC", "Severe delays.");
+  window_stack_pop(false);
+}
+
+static void test_reply_without_code_is_not_retried() {
+  wnd_line_detail_show("JU", "Jubilee", 1);
+  CHECK(strcmp(sent_code(), "JU") == 0);
+  uint8_t buffer[32];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_uint8(&iter, KEY_CODE, 1);
+  dict_write_end(&iter);
+  stub_http_reply(HTTP_LINE_DETAIL, 200, &iter);
+  CHECK(strcmp(sent_code(), "") == 0);
+  window_stack_pop(false);
+}
+
+int main(int argc, char** argv) {
+  stub_start_app();
+  stub_cookie_deliver_all();
+  RUN_TEST(test_detail_is_requested_for_the_line);
+  RUN_TEST(test_late_reply_sends_the_current_line);
+  RUN_TEST(test_code_must_match_exactly);
+  RUN_TEST(test_reply_without_code_is_not_retried);
+  return TEST_RESULT();
+}
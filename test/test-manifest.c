@@ -0,0 +1,198 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+#include "test.h"
+#include "diagnostics.h"
+#include "line-manifest.h"
+#include "chunk-assembly.h"
+#include "status-store.h"
+#include "wnd-tube-status.h"
+
+#define KEY_STATUS_MANIFEST 4
+#define KEY_MANIFEST_VERSION 0
+#define MANIFEST_CHUNK_SIZE 100
+
+// Every line the manifest has to hold, about 240 bytes of text.
+static const char* full_manifest = "BLBakerloo|CECentral|CICircle|DIDistrict|DLDLR|HCH'smith & City|JLJubilee|MEMetropolitan|NONorthern|OVOverground|PIPicadilly|VIVictoria|WCWaterloo & City|ELElizabeth|TRTrams|LBLiberty|LNLioness|MIMildmay|SFSuffragette|WVWeaver|WRWindrush";
+
+static StubRequest last_request;
+
+// Fires the flush timer and returns the cookie of the request it sent, or
+// 0 if nothing went out.
+static int32_t next_request() {
+  if (! stub_http_sent(&last_request) && ! (stub_timer_fire_next() && stub_http_sent(&last_request))) {
+    return 0;
+  }
+  return last_request.cookie;
+}
+
+// The chunk the last request asked for, or the first one.
+static uint32_t requested_chunk() {
+  DictionaryIterator iter;
+  Tuple* tuple = dict_read_begin_from_buffer(&iter, last_request.body, last_request.body_size);
+  while (tuple) {
+    if (tuple->key == CHUNK_KEY_INDEX) {
+      return tuple->value->uint8;
+    }
+    tuple = dict_read_next(&iter);
+  }
+  return 0;
+}
+
+static void reply_with_status_manifest(uint32_t version) {
+  uint8_t buffer[32];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_uint32(&iter, KEY_STATUS_MANIFEST, version);
+  dict_write_end(&iter);
+  stub_http_reply(HTTP_TUBE_STATUS, 200, &iter);
+}
+
+// Answers manifest requests with the chunks they ask for, until the app
+// sends something else, and returns that request's cookie.
+static int32_t reply_with_manifest(uint32_t version, const char* lines) {
+  uint16_t total = strlen(lines);
+  uint8_t count = (total + MANIFEST_CHUNK_SIZE - 1) / MANIFEST_CHUNK_SIZE;
+  int32_t cookie = HTTP_LINE_MANIFEST;
+  while (cookie == HTTP_LINE_MANIFEST) {
+    uint8_t index = requested_chunk();
+    uint16_t offset = index * MANIFEST_CHUNK_SIZE;
+    uint16_t length = total - offset < MANIFEST_CHUNK_SIZE ? total - offset : MANIFEST_CHUNK_SIZE;
+    uint8_t buffer[256];
+    DictionaryIterator iter;
+    dict_write_begin(&iter, buffer, sizeof(buffer));
+    dict_write_uint32(&iter, KEY_MANIFEST_VERSION, version);
+    dict_write_uint16(&iter, CHUNK_KEY_TRANSFER, version);
+    dict_write_uint8(&iter, CHUNK_KEY_INDEX, index);
+    dict_write_uint8(&iter, CHUNK_KEY_COUNT, count);
+    dict_write_uint16(&iter, CHUNK_KEY_OFFSET, offset);
+    dict_write_uint16(&iter, CHUNK_KEY_TOTAL, total);
+    dict_write_data(&iter, CHUNK_KEY_DATA, (const uint8_t*)lines + offset, length);
+    dict_write_end(&iter);
+    stub_http_reply(HTTP_LINE_MANIFEST, 200, &iter);
+    cookie = next_request();
+  }
+  return cookie;
+}
+
+static void test_new_manifest_is_fetched() {
+  wnd_tube_status_show();
+  CHECK_EQUAL(next_request(), HTTP_TUBE_STATUS);
+  reply_with_status_manifest(4);
+  CHECK_EQUAL(next_request(), HTTP_LINE_MANIFEST);
+  CHECK_EQUAL(reply_with_manifest(4, full_manifest), HTTP_TUBE_STATUS);
+  CHECK_EQUAL(line_manifest_version(), 4);
+  CHECK_EQUAL(line_manifest_count(), 21);
+  CHECK(strcmp(line_manifest_name(20), "Windrush") == 0);
+}
+
+// The manifest is too long for one cookie, so it is split over two.
+static void test_manifest_is_saved_in_two_parts() {
+  stub_cookie_deliver_all();
+  const uint8_t* first;
+  const uint8_t* rest;
+  uint16_t first_length;
+  uint16_t rest_length;
+  CHECK(stub_cookie_find(STATUS_STORE_MANIFEST, &first, &first_length));
+  CHECK(stub_cookie_find(STATUS_STORE_MANIFEST_REST, &rest, &rest_length));
+  CHECK_EQUAL(first_length, STATUS_STORE_MAX_LENGTH);
+  CHECK_EQUAL(first_length + rest_length, 6 + strlen(full_manifest));
+  CHECK_EQUAL(first[4] | (first[5] << 8), strlen(full_manifest));
+}
+
+static void test_stale_manifest_stops_fetching() {
+  uint32_t parse_errors = diagnostics_counter(DIAG_PARSE_ERRORS);
+  reply_with_status_manifest(5);
+  CHECK_EQUAL(next_request(), HTTP_LINE_MANIFEST);
+  CHECK_EQUAL(reply_with_manifest(4, "AAAlpha|BBBeta"), 0);
+  CHECK_EQUAL(line_manifest_count(), 21);
+  CHECK_EQUAL(diagnostics_counter(DIAG_PARSE_ERRORS), parse_errors);
+}
+
+// The version lines.php couldn't serve isn't asked for again, even after
+// a refresh, until the status replies name another one.
+static void test_rejected_version_is_not_fetched_again() {
+  uint32_t parse_errors = diagnostics_counter(DIAG_PARSE_ERRORS);
+  for (int refresh = 0; refresh < 3; refresh += 1) {
+    wnd_tube_status_refresh_timer();
+    CHECK_EQUAL(next_request(), HTTP_TUBE_STATUS);
+    reply_with_status_manifest(5);
+    CHECK_EQUAL(next_request(), 0);
+  }
+  CHECK_EQUAL(diagnostics_counter(DIAG_PARSE_ERRORS), parse_errors + 3);
+  wnd_tube_status_refresh_timer();
+  CHECK_EQUAL(next_request(), HTTP_TUBE_STATUS);
+  reply_with_status_manifest(6);
+  CHECK_EQUAL(next_request(), HTTP_LINE_MANIFEST);
+  CHECK_EQUAL(reply_with_manifest(6, full_manifest), HTTP_TUBE_STATUS);
+  CHECK_EQUAL(line_manifest_version(), 6);
+}
+
+static void test_alternating_manifest_is_limited() {
+  uint32_t parse_errors = diagnostics_counter(DIAG_PARSE_ERRORS);
+  int fetches = 0;
+  for (int round = 0; round < 10; round += 1) {
+    reply_with_status_manifest(100);
+    if (next_request() != HTTP_LINE_MANIFEST) {
+      break;
+    }
+    fetches += 1;
+    if (reply_with_manifest(10 + round, round % 2 ? "AAAlpha" : "BBBeta") != HTTP_TUBE_STATUS) {
+      break;
+    }
+  }
+  CHECK_EQUAL(fetches, 1);
+  CHECK_EQUAL(diagnostics_counter(DIAG_PARSE_ERRORS), parse_errors + 1);
+}
+
+// A manifest longer than the table can hold is rejected whole.
+static void test_oversized_manifest_is_rejected() {
+  char lines[400];
+  strcpy(lines, full_manifest);
+  while (strlen(lines) < 340) {
+    strcat(lines, "|XXExtra");
+  }
+  wnd_tube_status_refresh_timer();
+  CHECK_EQUAL(next_request(), HTTP_TUBE_STATUS);
+  reply_with_status_manifest(7);
+  CHECK_EQUAL(next_request(), HTTP_LINE_MANIFEST);
+  CHECK_EQUAL(reply_with_manifest(7, lines), 0);
+  CHECK(line_manifest_version() != 7);
+}
+
+int main(int argc, char** argv) {
+  stub_start_app();
+  stub_cookie_deliver_all();
+  while (next_request() != 0) {
+  }
+  RUN_TEST(test_new_manifest_is_fetched);
+  RUN_TEST(test_manifest_is_saved_in_two_parts);
+  RUN_TEST(test_stale_manifest_stops_fetching);
+  RUN_TEST(test_rejected_version_is_not_fetched_again);
+  RUN_TEST(test_alternating_manifest_is_limited);
+  RUN_TEST(test_oversized_manifest_is_rejected);
+  return TEST_RESULT();
+}
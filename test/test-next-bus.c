@@ -0,0 +1,85 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+#include "test.h"
+#include "request-scheduler.h"
+#include "status-store.h"
+#include "wnd-next-bus.h"
+
+#define KEY_STOPS 0
+#define KEY_SAVED_STOPS 2
+
+static const char* sent_stops() {
+  static StubRequest request;
+  while (! stub_http_sent(&request)) {
+    if (! stub_timer_fire_next()) {
+      return "";
+    }
+  }
+  DictionaryIterator iter;
+  Tuple* tuple = dict_read_begin_from_buffer(&iter, request.body, request.body_size);
+  tuple = tuple ? dict_find(&iter, KEY_STOPS) : NULL;
+  return tuple ? tuple->value->cstring : "";
+}
+
+static void reply_with_stops(const char* stops) {
+  uint8_t buffer[64];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_cstring(&iter, KEY_SAVED_STOPS, stops);
+  dict_write_end(&iter);
+  stub_http_reply(HTTP_NEXT_BUS, 200, &iter);
+}
+
+static void test_default_stops_until_saved() {
+  wnd_next_bus_show();
+  CHECK(strcmp(sent_stops(), "53272,47920") == 0);
+}
+
+static void test_server_list_is_saved_and_used() {
+  reply_with_stops("10001,10002,10003");
+  const uint8_t* data;
+  uint16_t length;
+  CHECK(stub_cookie_find(STATUS_STORE_STOPS, &data, &length));
+  CHECK_EQUAL(length, 17);
+  request_scheduler_send(HTTP_NEXT_BUS);
+  CHECK(strcmp(sent_stops(), "10001,10002,10003") == 0);
+}
+
+static void test_bad_list_is_ignored() {
+  reply_with_stops("10001;DROP");
+  request_scheduler_send(HTTP_NEXT_BUS);
+  CHECK(strcmp(sent_stops(), "10001,10002,10003") == 0);
+}
+
+int main(int argc, char** argv) {
+  stub_start_app();
+  stub_cookie_deliver_all();
+  RUN_TEST(test_default_stops_until_saved);
+  RUN_TEST(test_server_list_is_saved_and_used);
+  RUN_TEST(test_bad_list_is_ignored);
+  return TEST_RESULT();
+}
@@ -0,0 +1,168 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+#include "test.h"
+#include "config.h"
+#include "request-scheduler.h"
+#include "outbox.h"
+#include "wnd-next-bus.h"
+
+#define THANKS_COOKIE 8825
+#define OTHER_COOKIE 8840
+#define MAX_ATTEMPTS 5
+
+static StubRequest outbox_request;
+
+static void write_thanks(DictionaryIterator* body) {
+  dict_write_cstring(body, 0, "thanks");
+}
+
+// Fires timers until the outbox goes out, giving up after the given
+// number of timers.
+static bool outbox_sent_within(int timers) {
+  for (int t = 0; t <= timers; t += 1) {
+    if (stub_http_sent(&outbox_request) && outbox_request.cookie == HTTP_OUTBOX) {
+      return true;
+    }
+    if (t < timers && ! stub_timer_fire_next()) {
+      return false;
+    }
+  }
+  return false;
+}
+
+static void reply_with_cookies(int32_t first, int32_t second) {
+  uint8_t buffer[64];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  if (first) {
+    dict_write_int32(&iter, BATCH_KEY(0, BATCH_KEY_COOKIE), first);
+  }
+  if (second) {
+    dict_write_int32(&iter, BATCH_KEY(1, BATCH_KEY_COOKIE), second);
+  }
+  dict_write_end(&iter);
+  stub_http_reply(HTTP_OUTBOX, 200, &iter);
+}
+
+static void reply_to_other_request() {
+  uint8_t buffer[16];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_end(&iter);
+  stub_http_reply(HTTP_NEXT_BUS, 200, &iter);
+}
+
+static void test_answered_item_is_done() {
+  outbox_add(THANKS_COOKIE, write_thanks);
+  CHECK(outbox_sent_within(1));
+  reply_with_cookies(THANKS_COOKIE, 0);
+  CHECK_EQUAL(request_scheduler_state(HTTP_OUTBOX), REQUEST_IDLE);
+  reply_to_other_request();
+  CHECK(! outbox_sent_within(2));
+}
+
+static Tuple* find_in_request(uint32_t key) {
+  DictionaryIterator iter;
+  dict_read_begin_from_buffer(&iter, outbox_request.body, outbox_request.body_size);
+  return dict_find(&iter, key);
+}
+
+// A lone thanks goes to its own endpoint, written as it would be without
+// the outbox, and any reply from there means it was delivered.
+static void test_single_item_goes_to_its_endpoint() {
+  outbox_add(THANKS_COOKIE, write_thanks);
+  CHECK(outbox_sent_within(1));
+  CHECK(strstr(outbox_request.url, "/thanks/v1/thanks.php") != NULL);
+  CHECK(find_in_request(0) != NULL);
+  CHECK(find_in_request(BATCH_KEY(0, BATCH_KEY_COOKIE)) == NULL);
+  reply_with_cookies(0, 0);
+  CHECK_EQUAL(request_scheduler_state(HTTP_OUTBOX), REQUEST_IDLE);
+  reply_to_other_request();
+  CHECK(! outbox_sent_within(2));
+}
+
+static void test_several_items_are_batched() {
+  outbox_add(THANKS_COOKIE, write_thanks);
+  outbox_add(OTHER_COOKIE, write_thanks);
+  CHECK(outbox_sent_within(1));
+  CHECK(strcmp(outbox_request.url, BATCH_URL) == 0);
+  CHECK(find_in_request(BATCH_KEY(1, BATCH_KEY_COOKIE)) != NULL);
+  reply_with_cookies(THANKS_COOKIE, OTHER_COOKIE);
+  CHECK_EQUAL(request_scheduler_state(HTTP_OUTBOX), REQUEST_IDLE);
+}
+
+static void test_left_out_item_waits_for_backoff() {
+  outbox_add(THANKS_COOKIE, write_thanks);
+  outbox_add(OTHER_COOKIE, write_thanks);
+  CHECK(outbox_sent_within(1));
+  reply_with_cookies(THANKS_COOKIE, 0);
+  CHECK_EQUAL(request_scheduler_state(HTTP_OUTBOX), REQUEST_RETRY_WAIT);
+  CHECK(! stub_http_sent(NULL));
+  reply_to_other_request();
+  CHECK(! stub_http_sent(NULL));
+  CHECK_EQUAL(request_scheduler_state(HTTP_OUTBOX), REQUEST_RETRY_WAIT);
+  CHECK(outbox_sent_within(3));
+  reply_with_cookies(OTHER_COOKIE, 0);
+  CHECK_EQUAL(request_scheduler_state(HTTP_OUTBOX), REQUEST_IDLE);
+}
+
+static void test_item_never_answered_is_dropped() {
+  outbox_add(OTHER_COOKIE, write_thanks);
+  for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt += 1) {
+    CHECK(outbox_sent_within(2));
+    reply_with_cookies(0, 0);
+  }
+  CHECK_EQUAL(request_scheduler_state(HTTP_OUTBOX), REQUEST_FAILED);
+  reply_to_other_request();
+  CHECK(! outbox_sent_within(2));
+}
+
+static void test_failed_send_keeps_item() {
+  outbox_add(THANKS_COOKIE, write_thanks);
+  for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt += 1) {
+    CHECK(outbox_sent_within(2));
+    stub_http_fail(HTTP_OUTBOX, 500);
+  }
+  CHECK_EQUAL(request_scheduler_state(HTTP_OUTBOX), REQUEST_FAILED);
+  reply_to_other_request();
+  CHECK(outbox_sent_within(1));
+  reply_with_cookies(THANKS_COOKIE, 0);
+}
+
+int main(int argc, char** argv) {
+  stub_start_app();
+  stub_cookie_deliver_all();
+  while (stub_http_sent(NULL) || stub_timer_fire_next()) {
+  }
+  RUN_TEST(test_answered_item_is_done);
+  RUN_TEST(test_single_item_goes_to_its_endpoint);
+  RUN_TEST(test_several_items_are_batched);
+  RUN_TEST(test_left_out_item_waits_for_backoff);
+  RUN_TEST(test_item_never_answered_is_dropped);
+  RUN_TEST(test_failed_send_keeps_item);
+  return TEST_RESULT();
+}
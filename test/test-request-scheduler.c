@@ -0,0 +1,107 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+#include "test.h"
+#include "config.h"
+#include "request-scheduler.h"
+#include "wnd-next-bus.h"
+
+#define FIRST_COOKIE 9201
+
+static const ScheduledRequest first_request = {
+  .cookie = FIRST_COOKIE,
+  .url = "http://example.com/first"
+};
+
+// Fires timers until a request goes out and returns its cookie, or 0.
+static int32_t next_request(StubRequest* request) {
+  for (int t = 0; t < 4; t += 1) {
+    if (stub_http_sent(request)) {
+      return request->cookie;
+    }
+    if (! stub_timer_fire_next()) {
+      return 0;
+    }
+  }
+  return 0;
+}
+
+static void reply_empty(int32_t cookie) {
+  uint8_t buffer[16];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_end(&iter);
+  stub_http_reply(cookie, 200, &iter);
+}
+
+static void test_requests_queued_together_are_batched() {
+  StubRequest request;
+  request_scheduler_send(FIRST_COOKIE);
+  request_scheduler_send(HTTP_NEXT_BUS);
+  CHECK_EQUAL(next_request(&request), HTTP_BATCH);
+  CHECK(strcmp(request.url, BATCH_URL) == 0);
+}
+
+// A host without the batch endpoint answers 404. The parts then go to
+// their own URLs, one after the other, without using up an attempt. The
+// other part is the next bus request, since the app fills all but one of
+// the scheduler's slots, and it is sent first as it was registered first.
+static void test_missing_batch_endpoint_sends_parts_directly() {
+  StubRequest request;
+  stub_http_fail(HTTP_BATCH, 404);
+  CHECK_EQUAL(next_request(&request), HTTP_NEXT_BUS);
+  CHECK(strstr(request.url, "arrivals.php") != NULL);
+  CHECK_EQUAL(request_scheduler_attempts(HTTP_NEXT_BUS), 1);
+  reply_empty(HTTP_NEXT_BUS);
+  CHECK_EQUAL(next_request(&request), FIRST_COOKIE);
+  CHECK(strcmp(request.url, first_request.url) == 0);
+  CHECK_EQUAL(request_scheduler_attempts(FIRST_COOKIE), 1);
+  reply_empty(FIRST_COOKIE);
+  CHECK_EQUAL(request_scheduler_state(FIRST_COOKIE), REQUEST_IDLE);
+  CHECK_EQUAL(request_scheduler_state(HTTP_NEXT_BUS), REQUEST_IDLE);
+}
+
+static void test_unbatchable_requests_stay_direct() {
+  StubRequest request;
+  request_scheduler_send(FIRST_COOKIE);
+  request_scheduler_send(HTTP_NEXT_BUS);
+  CHECK_EQUAL(next_request(&request), HTTP_NEXT_BUS);
+  reply_empty(HTTP_NEXT_BUS);
+  CHECK_EQUAL(next_request(&request), FIRST_COOKIE);
+  reply_empty(FIRST_COOKIE);
+}
+
+int main(int argc, char** argv) {
+  stub_start_app();
+  stub_cookie_deliver_all();
+  while (stub_http_sent(NULL) || stub_timer_fire_next()) {
+  }
+  request_scheduler_register(&first_request);
+  RUN_TEST(test_requests_queued_together_are_batched);
+  RUN_TEST(test_missing_batch_endpoint_sends_parts_directly);
+  RUN_TEST(test_unbatchable_requests_stay_direct);
+  return TEST_RESULT();
+}
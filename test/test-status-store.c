@@ -0,0 +1,152 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+#include "test.h"
+#include "request-scheduler.h"
+#include "status-store.h"
+#include "diagnostics.h"
+
+#define KEY_FIRST 9001
+#define KEY_SECOND 9002
+#define BACKGROUND_COOKIE 9100
+
+static void save_both(int32_t cookie, int http_status, DictionaryIterator* received, void* context);
+
+static const ScheduledRequest background_request = {
+  .cookie = BACKGROUND_COOKIE,
+  .url = "http://example.com/background",
+  .success = save_both,
+  .background = true
+};
+
+static uint16_t loaded_length;
+
+static void save_value(uint32_t key, uint8_t value, uint16_t length) {
+  uint8_t data[STATUS_STORE_MAX_LENGTH];
+  memset(data, value, length);
+  status_store_save(key, data, length);
+}
+
+static bool saved_value(uint32_t key, uint8_t value, uint16_t length) {
+  const uint8_t* data;
+  uint16_t saved_length;
+  if (! stub_cookie_find(key, &data, &saved_length) || saved_length != length) {
+    return false;
+  }
+  for (uint16_t b = 0; b < length; b += 1) {
+    if (data[b] != value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void save_both(int32_t cookie, int http_status, DictionaryIterator* received, void* context) {
+  save_value(KEY_FIRST, 3, STATUS_STORE_MAX_LENGTH);
+  save_value(KEY_SECOND, 4, 64);
+}
+
+static void record_length(const uint8_t* data, uint16_t length) {
+  loaded_length = length;
+}
+
+static void reply_empty(int32_t cookie) {
+  uint8_t buffer[16];
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_end(&iter);
+  stub_http_reply(cookie, 200, &iter);
+}
+
+static void test_saves_in_a_row_all_land() {
+  save_value(KEY_FIRST, 1, STATUS_STORE_MAX_LENGTH);
+  save_value(KEY_SECOND, 2, 32);
+  stub_cookie_deliver_all();
+  CHECK(saved_value(KEY_FIRST, 1, STATUS_STORE_MAX_LENGTH));
+  CHECK(saved_value(KEY_SECOND, 2, 32));
+  CHECK_EQUAL(stub_counters.cookie_busy, 0);
+}
+
+static void test_save_waits_for_load() {
+  loaded_length = 0;
+  status_store_load(KEY_SECOND, record_length);
+  save_value(KEY_SECOND, 5, 16);
+  CHECK(stub_cookie_deliver());
+  CHECK_EQUAL(loaded_length, 32);
+  stub_cookie_deliver_all();
+  CHECK(saved_value(KEY_SECOND, 5, 16));
+  CHECK_EQUAL(stub_counters.cookie_busy, 0);
+}
+
+static void test_queued_save_is_replaced() {
+  uint32_t sets = stub_counters.cookie_sets;
+  save_value(KEY_FIRST, 6, 8);
+  save_value(KEY_SECOND, 7, 8);
+  save_value(KEY_SECOND, 8, 8);
+  stub_cookie_deliver_all();
+  CHECK_EQUAL(stub_counters.cookie_sets, sets + 2);
+  CHECK(saved_value(KEY_SECOND, 8, 8));
+}
+
+static void test_request_waits_for_saves() {
+  request_scheduler_register(&background_request);
+  request_scheduler_send(BACKGROUND_COOKIE);
+  StubRequest request;
+  while (! stub_http_sent(&request)) {
+    CHECK(stub_timer_fire_next());
+  }
+  reply_empty(BACKGROUND_COOKIE);
+  request_scheduler_send(BACKGROUND_COOKIE);
+  CHECK(! stub_http_sent(NULL));
+  CHECK(stub_timer_fire_next());
+  CHECK(stub_http_sent(&request));
+  CHECK_EQUAL(request.cookie, BACKGROUND_COOKIE);
+  CHECK(saved_value(KEY_FIRST, 3, STATUS_STORE_MAX_LENGTH));
+  CHECK(saved_value(KEY_SECOND, 4, 64));
+  CHECK_EQUAL(stub_counters.cookie_busy, 0);
+}
+
+static void test_full_queue_is_counted() {
+  uint32_t dropped = diagnostics_counter(DIAG_STORE_DROPPED);
+  for (int l = 0; l < 12; l += 1) {
+    status_store_load(KEY_FIRST, NULL);
+  }
+  stub_cookie_deliver_all();
+  CHECK(diagnostics_counter(DIAG_STORE_DROPPED) > dropped);
+}
+
+int main(int argc, char** argv) {
+  stub_start_app();
+  stub_cookie_deliver_all();
+  CHECK_EQUAL(diagnostics_counter(DIAG_STORE_DROPPED), 0);
+  CHECK_EQUAL(stub_counters.cookie_busy, 0);
+  RUN_TEST(test_saves_in_a_row_all_land);
+  RUN_TEST(test_save_waits_for_load);
+  RUN_TEST(test_queued_save_is_replaced);
+  RUN_TEST(test_request_waits_for_saves);
+  RUN_TEST(test_full_queue_is_counted);
+  return TEST_RESULT();
+}
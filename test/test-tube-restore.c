@@ -0,0 +1,131 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+#include "test.h"
+#include "line-manifest.h"
+#include "wnd-tube-status.h"
+
+// Runs the app twice: the first launch watches the first line and saves a
+// snapshot taken at 09:00, and the tests run in the second, which restores
+// it at 10:30.
+
+#define KEY_ORDER 0
+#define KEY_STATUSES 1
+#define KEY_SNAPSHOT 2
+#define KEY_MANIFEST 4
+
+#define STATUS_GOOD_SERVICE 0x001
+#define STATUS_MINOR_DELAYS 0x002
+
+static void reply_with_all(uint32_t snapshot, uint16_t status) {
+  uint8_t buffer[256];
+  uint8_t lines[MANIFEST_MAX_LINES];
+  uint8_t packed[MANIFEST_MAX_LINES * 2];
+  uint8_t count = line_manifest_count();
+  for (uint8_t l = 0; l < count; l += 1) {
+    lines[l] = l;
+    packed[l * 2] = status & 0xFF;
+    packed[l * 2 + 1] = status >> 8;
+  }
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_data(&iter, KEY_ORDER, lines, count);
+  dict_write_data(&iter, KEY_STATUSES, packed, count * 2);
+  dict_write_uint32(&iter, KEY_SNAPSHOT, snapshot);
+  dict_write_uint32(&iter, KEY_MANIFEST, line_manifest_version());
+  dict_write_end(&iter);
+  stub_http_reply(HTTP_TUBE_STATUS, 200, &iter);
+}
+
+static bool request_sent_within(int timers) {
+  StubRequest request;
+  for (int t = 0; t <= timers; t += 1) {
+    if (stub_http_sent(&request) && request.cookie == HTTP_TUBE_STATUS) {
+      return true;
+    }
+    if (t < timers && ! stub_timer_fire_next()) {
+      return false;
+    }
+  }
+  return false;
+}
+
+static void first_launch() {
+  stub_start_app();
+  stub_cookie_deliver_all();
+  wnd_tube_status_show();
+  CHECK(request_sent_within(1));
+  reply_with_all(1, STATUS_GOOD_SERVICE);
+  MenuLayer* menu = stub_top_menu_layer();
+  MenuIndex first_line = { .section = 0, .row = 0 };
+  menu->callbacks.select_long_click(menu, &first_line, menu->callback_context);
+}
+
+// The main menu shows the restored snapshot, but not as if it were new.
+static void test_restored_digest_shows_its_time() {
+  CHECK(strcmp(wnd_tube_status_digest(), "Watched good at 09:00") == 0);
+}
+
+// The restored snapshot is not what the user last saw, so the first fresh
+// status can't be said to have got worse. Later ones can.
+static void test_first_fresh_status_doesnt_buzz() {
+  uint32_t vibes = stub_counters.vibes;
+  wnd_tube_status_show();
+  CHECK(request_sent_within(1));
+  reply_with_all(2, STATUS_MINOR_DELAYS);
+  CHECK_EQUAL(stub_counters.vibes, vibes);
+  wnd_tube_status_refresh_timer();
+  CHECK(request_sent_within(1));
+  reply_with_all(3, STATUS_GOOD_SERVICE);
+  wnd_tube_status_refresh_timer();
+  CHECK(request_sent_within(1));
+  reply_with_all(4, STATUS_MINOR_DELAYS);
+  CHECK_EQUAL(stub_counters.vibes, vibes + 1);
+}
+
+static void test_fresh_digest_shows_its_time() {
+  wnd_tube_status_refresh_timer();
+  CHECK(request_sent_within(1));
+  reply_with_all(5, STATUS_GOOD_SERVICE);
+  CHECK(strcmp(wnd_tube_status_digest(), "Watched good at 10:30") == 0);
+}
+
+int main(int argc, char** argv) {
+  if (! stub_restarted()) {
+    first_launch();
+    if (TEST_RESULT() != 0) {
+      return TEST_RESULT();
+    }
+    stub_restart_app(argv);
+  }
+  stub_set_time(10, 30);
+  stub_start_app();
+  stub_cookie_deliver_all();
+  RUN_TEST(test_restored_digest_shows_its_time);
+  RUN_TEST(test_first_fresh_status_doesnt_buzz);
+  RUN_TEST(test_fresh_digest_shows_its_time);
+  return TEST_RESULT();
+}
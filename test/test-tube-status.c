@@ -0,0 +1,131 @@
+/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pebble_os.h"
+#include "pebble_app.h"
+#include "http.h"
+#include "stub.h"
+#include "test.h"
+#include "line-manifest.h"
+#include "status-store.h"
+#include "wnd-tube-status.h"
+
+#define KEY_ORDER 0
+#define KEY_STATUSES 1
+#define KEY_SNAPSHOT 2
+#define KEY_MANIFEST 4
+
+#define STATUS_GOOD_SERVICE 0x001
+#define STATUS_MINOR_DELAYS 0x002
+
+// Replies with a full update listing the given lines, in order.
+static void reply_with_statuses(uint32_t snapshot, const uint8_t* lines, const uint16_t* statuses, uint8_t count) {
+  uint8_t buffer[256];
+  uint8_t packed[MANIFEST_MAX_LINES * 2];
+  for (uint8_t l = 0; l < count; l += 1) {
+    packed[l * 2] = statuses[l] & 0xFF;
+    packed[l * 2 + 1] = statuses[l] >> 8;
+  }
+  DictionaryIterator iter;
+  dict_write_begin(&iter, buffer, sizeof(buffer));
+  dict_write_data(&iter, KEY_ORDER, lines, count);
+  dict_write_data(&iter, KEY_STATUSES, packed, count * 2);
+  dict_write_uint32(&iter, KEY_SNAPSHOT, snapshot);
+  dict_write_uint32(&iter, KEY_MANIFEST, line_manifest_version());
+  dict_write_end(&iter);
+  stub_http_reply(HTTP_TUBE_STATUS, 200, &iter);
+}
+
+// Every line in manifest order with the same status.
+static void reply_with_all(uint32_t snapshot, uint16_t status) {
+  uint8_t lines[MANIFEST_MAX_LINES];
+  uint16_t statuses[MANIFEST_MAX_LINES];
+  for (uint8_t l = 0; l < line_manifest_count(); l += 1) {
+    lines[l] = l;
+    statuses[l] = status;
+  }
+  reply_with_statuses(snapshot, lines, statuses, line_manifest_count());
+}
+
+static bool request_sent_within(int timers) {
+  StubRequest request;
+  for (int t = 0; t <= timers; t += 1) {
+    if (stub_http_sent(&request) && request.cookie == HTTP_TUBE_STATUS) {
+      return true;
+    }
+    if (t < timers && ! stub_timer_fire_next()) {
+      return false;
+    }
+  }
+  return false;
+}
+
+// The name drawn first in the row, which is the line's name.
+static const char* row_name(uint16_t row) {
+  MenuLayer* menu = stub_top_menu_layer();
+  MenuIndex index = { .section = 0, .row = row };
+  stub_text_log_clear();
+  menu->callbacks.draw_row(NULL, menu_layer_get_layer(menu), &index, menu->callback_context);
+  return stub_text_log(0);
+}
+
+static void test_status_change_saves_snapshot_and_history() {
+  CHECK(request_sent_within(1));
+  reply_with_all(1, STATUS_GOOD_SERVICE);
+  stub_cookie_deliver_all();
+  stub_cookie_clear();
+  uint32_t busy = stub_counters.cookie_busy;
+  wnd_tube_status_refresh_timer();
+  CHECK(request_sent_within(1));
+  reply_with_all(2, STATUS_MINOR_DELAYS);
+  stub_cookie_deliver_all();
+  const uint8_t* data;
+  uint16_t length;
+  CHECK(stub_cookie_find(STATUS_STORE_SNAPSHOT, &data, &length));
+  CHECK(stub_cookie_find(STATUS_STORE_HISTORY, &data, &length));
+  CHECK_EQUAL(stub_counters.cookie_busy, busy);
+}
+
+// With the watched filter on the server lists only the watched lines.
+// They come first, in its order, and the rest keep theirs after them.
+static void test_partial_update_puts_listed_lines_first() {
+  int metropolitan = line_manifest_find("ME");
+  int district = line_manifest_find("DI");
+  const uint8_t lines[] = { metropolitan, district };
+  const uint16_t statuses[] = { STATUS_MINOR_DELAYS, STATUS_GOOD_SERVICE };
+  wnd_tube_status_refresh_timer();
+  CHECK(request_sent_within(1));
+  reply_with_statuses(3, lines, statuses, 2);
+  CHECK(strcmp(row_name(0), "Metropolitan") == 0);
+  CHECK(strcmp(row_name(1), "District") == 0);
+  CHECK(strcmp(row_name(2), line_manifest_name(0)) == 0);
+  CHECK(strcmp(row_name(line_manifest_count() - 1), line_manifest_name(line_manifest_count() - 1)) == 0);
+}
+
+int main(int argc, char** argv) {
+  stub_start_app();
+  stub_cookie_deliver_all();
+  wnd_tube_status_show();
+  RUN_TEST(test_status_change_saves_snapshot_and_history);
+  RUN_TEST(test_partial_update_puts_listed_lines_first);
+  return TEST_RESULT();
+}
@@ -0,0 +1,350 @@
+#!/usr/bin/env python
+#
+# London Transport
+# Copyright (C) 2013 Matthew Tole
+#
+# A stand-in for the parts of api.pblweb.com the app talks to, for trying
+# out refreshes, retries and bad payloads without the live service. Set
+# API_BASE_URL in src/config.h to this machine's address as the phone sees
+# it, then run:
+#
+#   python tools/fake-api.py [--port 8080] [--scenario good]
+#
+# Scenarios:
+#   good        every line has a good service
+#   disrupted   most lines have one or more problems
+#   changing    a different line is disrupted every minute, for deltas
+#   chunked     disrupted, with line details and the manifest sent in small
+#               chunks and out of order, so the watch has to ask again
+#   slow        good, but every response waits longer than the app's timeout
+#   truncated   the statuses are cut short, which the app must reject
+#   error       every request fails with HTTP 500
+#
+# Status requests that ask for format version 3 or later get the packed
+# format: byte arrays of line indexes and little endian uint16 status
+# words. Older requests get the version 2 strings. A request that sends
+# the snapshot id it already has gets an unchanged reply, or a delta of
+# the lines that changed since, if that snapshot is still remembered.
+# Every response reports manifest version 1, so the manifest fetch is
+# exercised too. The manifest has every line the app's table can hold
+# and is sent in chunks, like line details.
+#
+# Byte arrays are sent as ["d", base64], which httpebble turns into a
+# byte array tuple.
+
+import argparse
+import base64
+import json
+import time
+import zlib
+
+try:
+  from http.server import BaseHTTPRequestHandler, HTTPServer
+except ImportError:
+  from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
+
+MANIFEST_VERSION = 1
+LINES = [
+  ('BL', 'Bakerloo'), ('CE', 'Central'), ('CI', 'Circle'), ('DI', 'District'),
+  ('DL', 'DLR'), ('HC', "H'smith & City"), ('JL', 'Jubilee'),
+  ('ME', 'Metropolitan'), ('NO', 'Northern'), ('OV', 'Overground'),
+  ('PI', 'Picadilly'), ('VI', 'Victoria'), ('WC', 'Waterloo & City'),
+  ('EL', 'Elizabeth'), ('TR', 'Trams'), ('LB', 'Liberty'), ('LN', 'Lioness'),
+  ('MI', 'Mildmay'), ('SF', 'Suffragette'), ('WV', 'Weaver'),
+  ('WR', 'Windrush'),
+]
+
+# Status bits, see src/tube-statuses.def.
+GOOD_SERVICE = 1
+MINOR_DELAYS = 2
+SEVERE_DELAYS = 16
+PART_CLOSURE = 32
+SUSPENDED = 256
+
+SLOW_SECONDS = 20
+CHANGE_SECONDS = 60
+
+# Cookies the app sends with each request, see the HTTP_* defines in src.
+HTTP_TUBE_STATUS = 8823
+HTTP_COOKIE_THANKS = 8825
+HTTP_NEXT_BUS = 8828
+HTTP_LINE_DETAIL = 8829
+HTTP_LINE_MANIFEST = 8830
+
+BATCH_KEY_COOKIE = 0xFFFF
+
+# Request keys, see write_status_request in src/wnd-tube-status.c.
+KEY_REQUEST_VERSION = '1'
+KEY_REQUEST_SNAPSHOT = '2'
+KEY_REQUEST_MANIFEST = '4'
+KEY_REQUEST_WATCHED = '5'
+
+# Response keys, see src/status-parser.c.
+KEY_STATUS_ORDER = '0'
+KEY_STATUS_STATUSES = '1'
+KEY_STATUS_SNAPSHOT = '2'
+KEY_STATUS_UPDATE_TYPE = '3'
+KEY_STATUS_MANIFEST = '4'
+
+UPDATE_FULL = 0
+UPDATE_UNCHANGED = 1
+UPDATE_DELTA = 2
+
+PACKED_FORMAT_VERSION = 3
+
+# Next bus, see src/wnd-next-bus.c. The server owns the list of stops and
+# sends it back whenever the watch's copy differs.
+KEY_BUS_STOPS = '0'
+KEY_BUS_ARRIVALS = '0'
+KEY_BUS_DESTINATIONS = '1'
+KEY_BUS_SAVED_STOPS = '2'
+BUS_STOPS = '53272,47920,10001'
+BUS_DESTINATIONS = ['Oxford Circus', 'Victoria', 'Waterloo', 'Aldwych']
+BUS_ROUTES = [(1101, '73', 0, 3), (1102, '390', 1, 7), (1103, 'N29', 2, 12), (1104, '176', 3, 20)]
+
+# Line detail and the manifest, see src/wnd-line-detail.c,
+# src/line-manifest.c and src/chunk-assembly.h.
+KEY_DETAIL_CODE = '0'
+KEY_MANIFEST_VERSION = '0'
+CHUNK_KEY_TRANSFER = str(0xFF00)
+CHUNK_KEY_INDEX = str(0xFF01)
+CHUNK_KEY_COUNT = str(0xFF02)
+CHUNK_KEY_OFFSET = str(0xFF03)
+CHUNK_KEY_TOTAL = str(0xFF04)
+CHUNK_KEY_DATA = str(0xFF05)
+CHUNK_SIZE = 64
+SMALL_CHUNK_SIZE = 16
+
+# Snapshot ids the server has handed out, so deltas can be worked out
+# against them.
+snapshots = {}
+transfers = {}
+
+
+def data_value(raw):
+  return ['d', base64.b64encode(bytes(bytearray(raw))).decode('ascii')]
+
+
+def line_statuses(scenario):
+  if scenario == 'changing':
+    statuses = [GOOD_SERVICE] * len(LINES)
+    statuses[int(time.time() // CHANGE_SECONDS) % len(LINES)] = SEVERE_DELAYS
+    return statuses
+  if scenario not in ('disrupted', 'chunked'):
+    return [GOOD_SERVICE] * len(LINES)
+  problems = [MINOR_DELAYS, SEVERE_DELAYS, MINOR_DELAYS | PART_CLOSURE, SUSPENDED]
+  return [problems[l % len(problems)] if l % 3 else GOOD_SERVICE for l in range(len(LINES))]
+
+
+# The same statuses always get the same id, kept positive so it survives
+# httpebble's signed integers.
+def snapshot_id(statuses):
+  snapshot = zlib.crc32(json.dumps(statuses).encode('ascii')) & 0x7FFFFFFF
+  snapshots[snapshot] = statuses
+  return snapshot
+
+
+def status_response(scenario, body):
+  watched = int(body.get(KEY_REQUEST_WATCHED, 0))
+  statuses = line_statuses(scenario)
+  positions = [l for l in range(len(LINES)) if not watched or watched & (1 << l)]
+  if int(body.get(KEY_REQUEST_VERSION, 0)) < PACKED_FORMAT_VERSION:
+    return v2_status_response(scenario, statuses, positions)
+
+  snapshot = snapshot_id(statuses)
+  response = {
+    KEY_STATUS_SNAPSHOT: snapshot,
+    KEY_STATUS_MANIFEST: MANIFEST_VERSION,
+  }
+  previous = snapshots.get(int(body.get(KEY_REQUEST_SNAPSHOT, 0)))
+  if previous == statuses:
+    response[KEY_STATUS_UPDATE_TYPE] = UPDATE_UNCHANGED
+    return response
+  if previous is not None:
+    positions = [l for l in positions if previous[l] != statuses[l]]
+    response[KEY_STATUS_UPDATE_TYPE] = UPDATE_DELTA
+  else:
+    response[KEY_STATUS_UPDATE_TYPE] = UPDATE_FULL
+  packed = []
+  for l in positions:
+    packed += [statuses[l] & 0xFF, statuses[l] >> 8]
+  if scenario == 'truncated':
+    packed = packed[:len(packed) // 2]
+  response[KEY_STATUS_ORDER] = data_value(positions)
+  response[KEY_STATUS_STATUSES] = data_value(packed)
+  return response
+
+
+def v2_status_response(scenario, statuses, positions):
+  order = ''.join(LINES[l][0] for l in positions)
+  status_text = ''.join('%03d' % statuses[l] for l in positions)
+  if scenario == 'truncated':
+    status_text = status_text[:len(status_text) // 2]
+  return {
+    KEY_STATUS_ORDER: order,
+    KEY_STATUS_STATUSES: status_text,
+    KEY_STATUS_MANIFEST: MANIFEST_VERSION,
+  }
+
+
+def manifest_response(scenario, body):
+  text = '|'.join(code + name for code, name in LINES).encode('ascii')
+  response = chunk_response(scenario, body, text)
+  response[KEY_MANIFEST_VERSION] = MANIFEST_VERSION
+  return response
+
+
+# Arrivals count down with the clock and start again at 30 minutes.
+def next_bus_response(scenario, body):
+  minute = int(time.time() // 60)
+  records = []
+  for vehicle, route, destination, due in BUS_ROUTES:
+    route = route.encode('ascii')[:4].ljust(4, b'\0')
+    records += [vehicle & 0xFF, vehicle >> 8] + list(bytearray(route)) + [destination, (due - minute) % 30]
+  response = {
+    KEY_BUS_ARRIVALS: data_value(records),
+    KEY_BUS_DESTINATIONS: '|'.join(BUS_DESTINATIONS),
+  }
+  if body.get(KEY_BUS_STOPS) != BUS_STOPS:
+    response[KEY_BUS_SAVED_STOPS] = BUS_STOPS
+  return response
+
+
+def detail_text(code, scenario):
+  name = dict(LINES).get(code, code)
+  text = '%s: ' % name
+  if scenario in ('disrupted', 'chunked', 'changing'):
+    text += ('Trains are not running between some stations because of '
+      'engineering work. Replacement buses operate, and tickets are '
+      'accepted on local buses and other reasonable routes.')
+  else:
+    text += 'A good service is operating.'
+  return text.encode('ascii')
+
+
+def detail_response(scenario, body):
+  code = body.get(KEY_DETAIL_CODE, '')
+  response = chunk_response(scenario, body, detail_text(code, scenario))
+  response[KEY_DETAIL_CODE] = code
+  return response
+
+
+# A request without a transfer id starts a new transfer; otherwise it asks
+# for one chunk by index. The chunked scenario uses small chunks. The
+# first time each one is asked for it sends its mirror image from the
+# other end instead, so chunks arrive out of order, and every third reply
+# repeats the last chunk, so the watch has to ask again.
+def chunk_response(scenario, body, text):
+  transfer = int(body.get(CHUNK_KEY_TRANSFER, 0))
+  index = int(body.get(CHUNK_KEY_INDEX, 0))
+  if transfer not in transfers:
+    transfer = len(transfers) + 1
+    size = SMALL_CHUNK_SIZE if scenario == 'chunked' else CHUNK_SIZE
+    transfers[transfer] = {
+      'chunks': [text[o:o + size] for o in range(0, len(text), size)],
+      'size': size,
+      'total': len(text),
+      'sent': set(),
+      'replies': 0,
+      'last': None,
+    }
+  state = transfers[transfer]
+  count = len(state['chunks'])
+  index = min(index, count - 1)
+  if scenario == 'chunked':
+    state['replies'] += 1
+    if state['replies'] % 3 == 0 and state['last'] is not None:
+      index = state['last']
+    elif count - 1 - index not in state['sent']:
+      index = count - 1 - index
+  state['sent'].add(index)
+  state['last'] = index
+  return {
+    CHUNK_KEY_TRANSFER: transfer,
+    CHUNK_KEY_INDEX: index,
+    CHUNK_KEY_COUNT: count,
+    CHUNK_KEY_OFFSET: index * state['size'],
+    CHUNK_KEY_TOTAL: state['total'],
+    CHUNK_KEY_DATA: data_value(state['chunks'][index]),
+  }
+
+
+def thanks_response(scenario, body):
+  return {}
+
+
+HANDLERS = {
+  '/london-tube/v2/status.php': status_response,
+  '/london-tube/v2/lines.php': manifest_response,
+  '/london-tube/v2/detail.php': detail_response,
+  '/london-bus/v1/arrivals.php': next_bus_response,
+  '/thanks/v1/thanks.php': thanks_response,
+}
+
+HANDLERS_BY_COOKIE = {
+  HTTP_TUBE_STATUS: status_response,
+  HTTP_LINE_MANIFEST: manifest_response,
+  HTTP_LINE_DETAIL: detail_response,
+  HTTP_NEXT_BUS: next_bus_response,
+  HTTP_COOKIE_THANKS: thanks_response,
+}
+
+
+# Each part of a batch has its keys moved into a block of its own, see
+# BATCH_KEY in src/request-scheduler.c. Parts for unknown cookies are left
+# out of the response, which the app treats as a failure.
+def batch_response(scenario, body):
+  parts = {}
+  for key, value in body.items():
+    key = int(key)
+    part, part_key = (key >> 16) - 1, key & 0xFFFF
+    parts.setdefault(part, {})[part_key] = value
+  response = {}
+  for part, keys in parts.items():
+    handler = HANDLERS_BY_COOKIE.get(int(keys.get(BATCH_KEY_COOKIE, 0)))
+    if not handler:
+      continue
+    part_body = dict((str(k), v) for k, v in keys.items() if k != BATCH_KEY_COOKIE)
+    response[str(((part + 1) << 16) | BATCH_KEY_COOKIE)] = keys[BATCH_KEY_COOKIE]
+    for key, value in handler(scenario, part_body).items():
+      response[str(((part + 1) << 16) | int(key))] = value
+  return response
+
+HANDLERS['/batch/v1/batch.php'] = batch_response
+
+
+def make_handler(scenario):
+  class Handler(BaseHTTPRequestHandler):
+    def do_POST(self):
+      length = int(self.headers.get('Content-Length', 0))
+      body = json.loads(self.rfile.read(length) or '{}')
+      handler = HANDLERS.get(self.path.split('?')[0])
+      if scenario == 'slow':
+        time.sleep(SLOW_SECONDS)
+      if not handler or scenario == 'error':
+        self.send_response(404 if not handler else 500)
+        self.end_headers()
+        return
+      payload = json.dumps(handler(scenario, body)).encode('utf-8')
+      self.send_response(200)
+      self.send_header('Content-Type', 'application/json')
+      self.send_header('Content-Length', str(len(payload)))
+      self.end_headers()
+      self.wfile.write(payload)
+
+    do_GET = do_POST
+  return Handler
+
+
+def main():
+  parser = argparse.ArgumentParser(description='Fake London Transport API')
+  parser.add_argument('--port', type=int, default=8080)
+  parser.add_argument('--scenario', default='good', choices=['good', 'disrupted', 'changing', 'chunked', 'slow', 'truncated', 'error'])
+  args = parser.parse_args()
+  server = HTTPServer(('', args.port), make_handler(args.scenario))
+  print('Serving the %s scenario on port %d' % (args.scenario, args.port))
+  server.serve_forever()
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,163 @@
+#!/usr/bin/env python
+#
+# London Transport
+# Copyright (C) 2013 Matthew Tole
+#
+# Packs the menu icons into a single 1-bit PNG so the watch only loads one
+# bitmap, and writes the offset of each icon into src/icon-atlas.h.
+#
+# Run from the root of the project after changing any of the icons:
+#
+#   python tools/pack-icons.py
+#
+# Only 1-bit palette PNGs (as exported for the Pebble) are supported.
+
+import os
+import struct
+import zlib
+
+IMAGES_DIR = os.path.join('resources', 'src', 'images')
+ATLAS_FILE = os.path.join(IMAGES_DIR, 'icon_atlas.png')
+HEADER_FILE = os.path.join('src', 'icon-atlas.h')
+
+# Icons are laid out left to right in this order.
+ICONS = [
+  ('ICON_ATLAS_MENU_TUBE', 'menu_tube.png'),
+  ('ICON_ATLAS_MENU_BUS', 'menu_bus.png'),
+  ('ICON_ATLAS_MENU_THANKS', 'menu_thanks.png'),
+  ('ICON_ATLAS_STATUS_OK', 'menu_tick_small.png'),
+  ('ICON_ATLAS_STATUS_PROBLEM', 'menu_exclamation_small.png'),
+  ('ICON_ATLAS_STATUS_UNKNOWN', 'menu_question_small.png'),
+]
+
+HEADER_TEMPLATE = '''/*
+ * London Transport
+ * Copyright (C) 2013 Matthew Tole
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Generated by tools/pack-icons.py. Do not edit.
+
+#ifndef ICON_ATLAS_H
+#define ICON_ATLAS_H
+
+// Position of each icon inside RESOURCE_ID_ICON_ATLAS.
+%s
+
+#endif // ICON_ATLAS_H
+'''
+
+
+def read_chunks(data):
+  pos = 8
+  while pos < len(data):
+    length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+    yield kind, data[pos + 8:pos + 8 + length]
+    pos += 12 + length
+
+
+# Returns (width, height, rows) where each row is a list of 0 (black) or
+# 1 (white) pixels.
+def read_png(path):
+  data = open(path, 'rb').read()
+  header = None
+  palette = None
+  idat = b''
+  for kind, body in read_chunks(data):
+    if kind == b'IHDR':
+      header = struct.unpack('>IIBBBBB', body)
+    elif kind == b'PLTE':
+      palette = [body[i:i + 3] for i in range(0, len(body), 3)]
+    elif kind == b'IDAT':
+      idat += body
+  width, height, depth, colour, _, _, interlace = header
+  if depth != 1 or colour != 3 or interlace != 0:
+    raise ValueError('%s is not a 1-bit palette PNG' % path)
+  white = [sum(bytearray(entry)) > 381 for entry in palette]
+  raw = bytearray(zlib.decompress(idat))
+  stride = (width + 7) // 8
+  rows = []
+  previous = bytearray(stride)
+  for y in range(height):
+    start = y * (stride + 1)
+    row = unfilter(raw[start], raw[start + 1:start + 1 + stride], previous)
+    previous = row
+    rows.append([1 if white[(row[x // 8] >> (7 - x % 8)) & 1] else 0 for x in range(width)])
+  return width, height, rows
+
+
+def unfilter(kind, row, previous):
+  out = bytearray(row)
+  for i in range(len(out)):
+    left = out[i - 1] if i > 0 else 0
+    up = previous[i]
+    up_left = previous[i - 1] if i > 0 else 0
+    if kind == 1:
+      out[i] = (out[i] + left) & 0xff
+    elif kind == 2:
+      out[i] = (out[i] + up) & 0xff
+    elif kind == 3:
+      out[i] = (out[i] + (left + up) // 2) & 0xff
+    elif kind == 4:
+      p = left + up - up_left
+      pa, pb, pc = abs(p - left), abs(p - up), abs(p - up_left)
+      pred = left if pa <= pb and pa <= pc else (up if pb <= pc else up_left)
+      out[i] = (out[i] + pred) & 0xff
+  return out
+
+
+def write_png(path, width, height, pixels):
+  def chunk(kind, body):
+    return struct.pack('>I', len(body)) + kind + body + struct.pack('>I', zlib.crc32(kind + body) & 0xffffffff)
+  raw = bytearray()
+  for y in range(height):
+    raw.append(0)
+    for x in range(0, width, 8):
+      byte = 0
+      for bit in range(8):
+        if x + bit < width and pixels[y][x + bit]:
+          byte |= 0x80 >> bit
+      raw.append(byte)
+  png = b'\x89PNG\r\n\x1a\n'
+  png += chunk(b'IHDR', struct.pack('>IIBBBBB', width, height, 1, 3, 0, 0, 0))
+  png += chunk(b'PLTE', b'\x00\x00\x00\xff\xff\xff')
+  png += chunk(b'IDAT', zlib.compress(bytes(raw), 9))
+  png += chunk(b'IEND', b'')
+  open(path, 'wb').write(png)
+
+
+def main():
+  images = [(name, read_png(os.path.join(IMAGES_DIR, filename))) for name, filename in ICONS]
+  width = sum(image[0] for _, image in images)
+  height = max(image[1] for _, image in images)
+  # Unused space is left white, the same as the menu background.
+  pixels = [[1] * width for _ in range(height)]
+  defines = []
+  x = 0
+  for name, (w, h, rows) in images:
+    for y in range(h):
+      pixels[y][x:x + w] = rows[y]
+    defines.append('#define %s GRect(%d, 0, %d, %d)' % (name, x, w, h))
+    x += w
+  write_png(ATLAS_FILE, width, height, pixels)
+  open(HEADER_FILE, 'w').write(HEADER_TEMPLATE % '\n'.join(defines))
+
+
+if __name__ == '__main__':
+  main()